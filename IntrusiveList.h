@@ -0,0 +1,348 @@
+#ifndef INTRUSIVELIST_H
+#define INTRUSIVELIST_H
+
+#include <bit>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+#include "StackAllocator.h"
+
+// kNormal hooks cost nothing beyond the two links. kSafe hooks are nulled when
+// unlinked and IntrusiveList refuses to insert a hook that is still linked.
+// kAutoUnlink hooks are safe hooks that also unlink themselves when the
+// object is destroyed; lists of them keep no count and size() walks the list.
+enum class LinkMode {
+    kNormal,
+    kSafe,
+    kAutoUnlink,
+};
+
+template <LinkMode Mode = LinkMode::kNormal>
+class IntrusiveListHook : public ListBaseNode {
+public:
+    static constexpr LinkMode kMode = Mode;
+
+    IntrusiveListHook() noexcept : ListBaseNode { nullptr, nullptr } {
+    }
+
+    // Copying an object does not copy its list membership.
+    IntrusiveListHook(const IntrusiveListHook&) noexcept : IntrusiveListHook() {
+    }
+
+    IntrusiveListHook& operator=(const IntrusiveListHook&) noexcept {
+        return *this;
+    }
+
+    ~IntrusiveListHook() {
+        if constexpr (Mode == LinkMode::kAutoUnlink) {
+            unlink();
+        }
+    }
+
+    // Only meaningful for kSafe and kAutoUnlink hooks.
+    bool is_linked() const noexcept {
+        return next != nullptr;
+    }
+
+    void unlink() noexcept {
+        if (next != nullptr) {
+            previous->next = next;
+            next->previous = previous;
+            next = nullptr;
+            previous = nullptr;
+        }
+    }
+};
+
+template <typename T, auto Hook>
+class IntrusiveList;
+
+// Links objects through a hook member, IntrusiveList<Task, &Task::hook>.
+// Linking and unlinking never allocate; the list does not own its elements.
+template <typename T, LinkMode Mode, IntrusiveListHook<Mode> T::*Hook>
+class IntrusiveList<T, Hook> {
+    using BaseNode = ListBaseNode;
+    using HookType = IntrusiveListHook<Mode>;
+
+    static constexpr bool kSafe = Mode != LinkMode::kNormal;
+    static constexpr bool kCountsSize = Mode != LinkMode::kAutoUnlink;
+
+    // Under the Itanium C++ ABI, which GCC and Clang follow, a pointer to
+    // data member is the member's offset in the object.
+    static_assert(sizeof(Hook) == sizeof(std::ptrdiff_t), "IntrusiveList needs the Itanium member pointer layout");
+
+    static std::ptrdiff_t HookOffset() noexcept {
+        return std::bit_cast<std::ptrdiff_t>(Hook);
+    }
+
+    static T* ToValue(BaseNode* node) noexcept {
+        return reinterpret_cast<T*>(reinterpret_cast<unsigned char*>(static_cast<HookType*>(node)) - HookOffset());
+    }
+
+    static BaseNode* ToNode(T& value) noexcept {
+        return &(value.*Hook);
+    }
+
+    template <bool IsConst>
+    struct Iterator {
+    public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::bidirectional_iterator_tag;
+        using pointer = std::conditional_t<IsConst, const T*, T*>;
+        using reference = std::conditional_t<IsConst, const T&, T&>;
+
+    private:
+        BaseNode* now_node = nullptr;
+
+    public:
+        friend class IntrusiveList;
+
+        Iterator() = default;
+
+        Iterator(BaseNode* node) : now_node(node) {
+        }
+
+        Iterator(const Iterator<false>& iterator)
+            requires(IsConst)
+        : Iterator(iterator.now_node) {
+        }
+
+        Iterator(const Iterator<IsConst>& iterator) = default;
+
+        Iterator& operator=(const Iterator<false>& iterator) {
+            now_node = iterator.now_node;
+            return *this;
+        }
+
+        reference operator*() const {
+            return *ToValue(now_node);
+        }
+
+        pointer operator->() const {
+            return ToValue(now_node);
+        }
+
+        Iterator& operator++() {
+            now_node = now_node->next;
+            return *this;
+        }
+
+        Iterator& operator--() {
+            now_node = now_node->previous;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        Iterator operator--(int) {
+            Iterator tmp = *this;
+            --*this;
+            return tmp;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return other.now_node == now_node;
+        }
+
+        bool operator!=(const Iterator& other) const = default;
+    };
+
+    struct NoSize {};
+
+    BaseNode fake_node;
+    [[no_unique_address]] std::conditional_t<kCountsSize, std::size_t, NoSize> size_ {};
+
+public:
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using difference_type = std::ptrdiff_t;
+
+    IntrusiveList() noexcept {
+        fake_node.next = &fake_node;
+        fake_node.previous = &fake_node;
+    }
+
+    IntrusiveList(const IntrusiveList&) = delete;
+
+    IntrusiveList& operator=(const IntrusiveList&) = delete;
+
+    IntrusiveList(IntrusiveList&& other) noexcept : IntrusiveList() {
+        splice(end(), other);
+    }
+
+    IntrusiveList& operator=(IntrusiveList&& other) noexcept {
+        if (this != &other) {
+            clear();
+            splice(end(), other);
+        }
+        return *this;
+    }
+
+    ~IntrusiveList() {
+        clear();
+    }
+
+    // Linear for kAutoUnlink hooks, which may leave the list on their own.
+    std::size_t size() const noexcept {
+        if constexpr (kCountsSize) {
+            return size_;
+        }
+        else {
+            return std::distance(begin(), end());
+        }
+    }
+
+    bool empty() const noexcept {
+        return fake_node.next == &fake_node;
+    }
+
+    iterator begin() noexcept {
+        return fake_node.next;
+    }
+
+    const_iterator begin() const noexcept {
+        return fake_node.next;
+    }
+
+    iterator end() noexcept {
+        return iterator(Sentinel());
+    }
+
+    const_iterator end() const noexcept {
+        return const_iterator(Sentinel());
+    }
+
+    reverse_iterator rbegin() noexcept {
+        return std::reverse_iterator(end());
+    }
+
+    const_reverse_iterator rbegin() const noexcept {
+        return std::reverse_iterator(end());
+    }
+
+    reverse_iterator rend() noexcept {
+        return std::reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rend() const noexcept {
+        return std::reverse_iterator(begin());
+    }
+
+    // O(1) iterator to an element already linked into this list.
+    iterator iterator_to(T& value) noexcept {
+        return iterator(ToNode(value));
+    }
+
+    const_iterator iterator_to(const T& value) const noexcept {
+        return const_iterator(ToNode(const_cast<T&>(value)));
+    }
+
+    iterator insert(const_iterator pos, T& value) {
+        BaseNode* node = ToNode(value);
+        if constexpr (kSafe) {
+            if (static_cast<HookType*>(node)->is_linked()) {
+                throw std::logic_error("IntrusiveList: element is already linked");
+            }
+        }
+        node->previous = pos.now_node->previous;
+        node->next = pos.now_node;
+        node->previous->next = node;
+        node->next->previous = node;
+        AddSize(1);
+        return iterator(node);
+    }
+
+    iterator erase(const_iterator pos) noexcept {
+        BaseNode* next = pos.now_node->next;
+        Unlink(pos.now_node);
+        AddSize(-1);
+        return next;
+    }
+
+    void push_back(T& value) {
+        insert(end(), value);
+    }
+
+    void push_front(T& value) {
+        insert(begin(), value);
+    }
+
+    void pop_back() noexcept {
+        erase(--end());
+    }
+
+    void pop_front() noexcept {
+        erase(begin());
+    }
+
+    T& front() noexcept {
+        return *begin();
+    }
+
+    T& back() noexcept {
+        return *--end();
+    }
+
+    void splice(const_iterator pos, IntrusiveList& other) noexcept {
+        if (&other == this || other.empty()) {
+            return;
+        }
+        BaseNode* first = other.fake_node.next;
+        BaseNode* last = other.fake_node.previous;
+        other.fake_node.next = &other.fake_node;
+        other.fake_node.previous = &other.fake_node;
+        first->previous = pos.now_node->previous;
+        last->next = pos.now_node;
+        pos.now_node->previous->next = first;
+        pos.now_node->previous = last;
+        if constexpr (kCountsSize) {
+            size_ += other.size_;
+            other.size_ = 0;
+        }
+    }
+
+    // Unlinks every element; with safe hooks each one is marked unlinked,
+    // otherwise this is O(1).
+    void clear() noexcept {
+        if constexpr (kSafe) {
+            while (!empty()) {
+                Unlink(fake_node.next);
+            }
+        }
+        fake_node.next = &fake_node;
+        fake_node.previous = &fake_node;
+        size_ = {};
+    }
+
+private:
+    BaseNode* Sentinel() const noexcept {
+        return const_cast<BaseNode*>(&fake_node);
+    }
+
+    void AddSize(std::ptrdiff_t delta) noexcept {
+        if constexpr (kCountsSize) {
+            size_ += delta;
+        }
+    }
+
+    static void Unlink(BaseNode* node) noexcept {
+        if constexpr (kSafe) {
+            static_cast<HookType*>(node)->unlink();
+        }
+        else {
+            node->previous->next = node->next;
+            node->next->previous = node->previous;
+        }
+    }
+};
+
+#endif  // INTRUSIVELIST_H
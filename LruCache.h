@@ -0,0 +1,272 @@
+#ifndef LRUCACHE_H
+#define LRUCACHE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "StackAllocator.h"
+
+// Entries live in a List ordered from most to least recently used; a hit is
+// a splice to the front. The index is a flat linear-probing table of list
+// iterators and cached hashes, at least twice the capacity and never
+// rehashed. Once full, the least recently used node is reused for the new
+// entry, so a warm cache does not allocate.
+template <typename K, typename V, typename Alloc = std::allocator<std::pair<K, V> >,
+          typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K> >
+class LruCache {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+    using allocator_type = Alloc;
+    using evict_callback = std::function<void(const K&, V&)>;
+
+private:
+    using Entries = List<value_type, typename std::allocator_traits<Alloc>::template rebind_alloc<value_type> >;
+    using EntryIterator = typename Entries::iterator;
+
+    struct Slot {
+        EntryIterator entry;
+        std::size_t hash = 0;
+    };
+
+    using SlotAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Slot>;
+
+    static constexpr std::size_t kNotFound = static_cast<std::size_t>(-1);
+
+    Entries entries_;
+    std::vector<Slot, SlotAlloc> slots_;
+    std::size_t capacity_;
+    std::size_t mask_ = 0;
+    [[no_unique_address]] Hash hash_;
+    [[no_unique_address]] KeyEqual equal_;
+    evict_callback on_evict_;
+
+public:
+    using const_iterator = typename Entries::const_iterator;
+
+    explicit LruCache(std::size_t capacity, Alloc alloc = Alloc())
+        : LruCache(capacity, evict_callback(), alloc) {
+    }
+
+    // on_evict sees every entry pushed out by capacity, before it is reused.
+    // If it throws, the entry is evicted all the same and the new one is not
+    // inserted.
+    LruCache(std::size_t capacity, evict_callback on_evict, Alloc alloc = Alloc())
+        : entries_(alloc), slots_(SlotAlloc(alloc)), capacity_(capacity), on_evict_(std::move(on_evict)) {
+        if (capacity_ == 0) {
+            return;
+        }
+        std::size_t slots = 2;
+        while (slots < 2 * capacity_) {
+            slots *= 2;
+        }
+        slots_.resize(slots);
+        mask_ = slots - 1;
+    }
+
+    LruCache(const LruCache& other)
+        : entries_(other.entries_), slots_(other.slots_.size(), Slot(), other.slots_.get_allocator()),
+          capacity_(other.capacity_), mask_(other.mask_), hash_(other.hash_), equal_(other.equal_),
+          on_evict_(other.on_evict_) {
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            Index(it, Mix(hash_(it->first)));
+        }
+    }
+
+    // The moved-from cache is left empty with zero capacity.
+    LruCache(LruCache&& other) noexcept
+        : entries_(std::move(other.entries_)), slots_(std::move(other.slots_)), capacity_(other.capacity_),
+          mask_(other.mask_), hash_(std::move(other.hash_)), equal_(std::move(other.equal_)),
+          on_evict_(std::move(other.on_evict_)) {
+        other.slots_.clear();
+        other.capacity_ = 0;
+        other.mask_ = 0;
+    }
+
+    LruCache& operator=(const LruCache&) = delete;
+
+    LruCache& operator=(LruCache&&) = delete;
+
+    std::size_t size() const noexcept {
+        return entries_.size();
+    }
+
+    std::size_t capacity() const noexcept {
+        return capacity_;
+    }
+
+    bool empty() const noexcept {
+        return entries_.size() == 0;
+    }
+
+    // Most recently used first.
+    const_iterator begin() const {
+        return entries_.begin();
+    }
+
+    const_iterator end() const {
+        return entries_.end();
+    }
+
+    // Marks the entry as most recently used. Returns nullptr on a miss.
+    V* find(const K& key) {
+        std::size_t pos = Find(key, Mix(hash_(key)));
+        if (pos == kNotFound) {
+            return nullptr;
+        }
+        EntryIterator entry = slots_[pos].entry;
+        entries_.splice(entries_.begin(), entries_, entry);
+        return &entry->second;
+    }
+
+    // Looks the entry up without touching its recency.
+    const V* peek(const K& key) const {
+        std::size_t pos = Find(key, Mix(hash_(key)));
+        return pos == kNotFound ? nullptr : &slots_[pos].entry->second;
+    }
+
+    bool contains(const K& key) const {
+        return Find(key, Mix(hash_(key))) != kNotFound;
+    }
+
+    // Inserts or overwrites the entry and marks it as most recently used,
+    // evicting the least recently used entry when the cache is full.
+    V& put(const K& key, V value) {
+        return Put(K(key), std::move(value));
+    }
+
+    V& put(K&& key, V value) {
+        return Put(std::move(key), std::move(value));
+    }
+
+    bool erase(const K& key) {
+        std::size_t pos = Find(key, Mix(hash_(key)));
+        if (pos == kNotFound) {
+            return false;
+        }
+        EntryIterator entry = slots_[pos].entry;
+        Unindex(pos);
+        entries_.erase(entry);
+        return true;
+    }
+
+    void clear() {
+        entries_.clear();
+        std::fill(slots_.begin(), slots_.end(), Slot());
+    }
+
+    Alloc get_allocator() const {
+        return Alloc(entries_.get_allocator());
+    }
+
+private:
+    // Spreads identity hashes such as std::hash<int> over the high bits.
+    static std::size_t Mix(std::size_t hash) noexcept {
+        return static_cast<std::size_t>(static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15ull >> 32) ^ hash;
+    }
+
+    static bool IsEmpty(const Slot& slot) noexcept {
+        return slot.entry == EntryIterator();
+    }
+
+    std::size_t Find(const K& key, std::size_t hash) const {
+        if (slots_.empty()) {
+            return kNotFound;
+        }
+        for (std::size_t pos = hash & mask_;; pos = (pos + 1) & mask_) {
+            const Slot& slot = slots_[pos];
+            if (IsEmpty(slot)) {
+                return kNotFound;
+            }
+            if (slot.hash == hash && equal_(slot.entry->first, key)) {
+                return pos;
+            }
+        }
+    }
+
+    void Index(EntryIterator entry, std::size_t hash) noexcept {
+        std::size_t pos = hash & mask_;
+        while (!IsEmpty(slots_[pos])) {
+            pos = (pos + 1) & mask_;
+        }
+        slots_[pos] = Slot { entry, hash };
+    }
+
+    // Backward-shift deletion: later members of the probe run move into the
+    // hole when that does not put them before their home slot.
+    void Unindex(std::size_t hole) noexcept {
+        for (std::size_t pos = (hole + 1) & mask_; !IsEmpty(slots_[pos]); pos = (pos + 1) & mask_) {
+            std::size_t home = slots_[pos].hash & mask_;
+            if (((pos - home) & mask_) >= ((pos - hole) & mask_)) {
+                slots_[hole] = slots_[pos];
+                hole = pos;
+            }
+        }
+        slots_[hole] = Slot();
+    }
+
+    void Unindex(EntryIterator entry) noexcept {
+        Unindex(Find(entry->first, Mix(hash_(entry->first))));
+    }
+
+    V& Put(K&& key, V&& value) {
+        std::size_t hash = Mix(hash_(key));
+        std::size_t pos = Find(key, hash);
+        if (pos != kNotFound) {
+            EntryIterator entry = slots_[pos].entry;
+            entry->second = std::move(value);
+            entries_.splice(entries_.begin(), entries_, entry);
+            return entry->second;
+        }
+        if (capacity_ == 0) {
+            throw std::length_error("LruCache has zero capacity");
+        }
+        if (entries_.size() < capacity_) {
+            entries_.emplace_front(std::move(key), std::move(value));
+            Index(entries_.begin(), hash);
+            return entries_.begin()->second;
+        }
+        EntryIterator victim = std::prev(entries_.end());
+        Unindex(victim);
+        if constexpr (std::is_move_assignable_v<K> && std::is_move_assignable_v<V>) {
+            try {
+                if (on_evict_) {
+                    on_evict_(victim->first, victim->second);
+                }
+                victim->first = std::move(key);
+                victim->second = std::move(value);
+            }
+            catch (...) {
+                entries_.erase(victim);
+                throw;
+            }
+            entries_.splice(entries_.begin(), entries_, victim);
+        }
+        else {
+            try {
+                if (on_evict_) {
+                    on_evict_(victim->first, victim->second);
+                }
+            }
+            catch (...) {
+                entries_.erase(victim);
+                throw;
+            }
+            entries_.erase(victim);
+            entries_.emplace_front(std::move(key), std::move(value));
+            victim = entries_.begin();
+        }
+        Index(victim, hash);
+        return victim->second;
+    }
+};
+
+#endif  // LRUCACHE_H
@@ -0,0 +1,148 @@
+#ifndef POOLALLOCATOR_H
+#define POOLALLOCATOR_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+// Size-class pool: small requests are served from per-class intrusive free
+// lists whose slots are carved out of large slabs, so a freed node is handed
+// straight back to the next allocation of the same size class.
+class PoolStorage {
+public:
+    static constexpr std::size_t kGranularity = alignof(std::max_align_t);
+    static constexpr std::size_t kMaxSlot = 512;
+    static constexpr std::size_t kClasses = kMaxSlot / kGranularity;
+    static constexpr std::size_t kSlabSize = 64 * 1024;
+
+    PoolStorage() = default;
+
+    PoolStorage(const PoolStorage&) = delete;
+
+    PoolStorage& operator=(const PoolStorage&) = delete;
+
+    ~PoolStorage() {
+        while (slabs_ != nullptr) {
+            Slab* next = slabs_->next;
+            ::operator delete(slabs_);
+            slabs_ = next;
+        }
+    }
+
+    void* allocate_raw(std::size_t st_mem, std::size_t sz) {
+        if (!IsPooled(st_mem, sz)) {
+            return ::operator new(sz, std::align_val_t(st_mem));
+        }
+        std::size_t cls = ClassOf(sz);
+        if (free_[cls] != nullptr) {
+            FreeSlot* slot = free_[cls];
+            free_[cls] = slot->next;
+            return slot;
+        }
+        std::size_t slot_size = (cls + 1) * kGranularity;
+        if (static_cast<std::size_t>(end_[cls] - cursor_[cls]) < slot_size) {
+            AddSlab(cls);
+        }
+        cursor_[cls] += slot_size;
+        return cursor_[cls] - slot_size;
+    }
+
+    void deallocate_raw(void* ptr, std::size_t st_mem, std::size_t sz) noexcept {
+        if (!IsPooled(st_mem, sz)) {
+            ::operator delete(ptr, std::align_val_t(st_mem));
+            return;
+        }
+        std::size_t cls = ClassOf(sz);
+        auto* slot = static_cast<FreeSlot*>(ptr);
+        slot->next = free_[cls];
+        free_[cls] = slot;
+    }
+
+private:
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    struct alignas(std::max_align_t) Slab {
+        Slab* next;
+    };
+
+    FreeSlot* free_[kClasses] {};
+    char* cursor_[kClasses] {};
+    char* end_[kClasses] {};
+    Slab* slabs_ = nullptr;
+
+    static bool IsPooled(std::size_t st_mem, std::size_t sz) noexcept {
+        return sz != 0 && sz <= kMaxSlot && st_mem <= kGranularity;
+    }
+
+    static std::size_t ClassOf(std::size_t sz) noexcept {
+        return (sz - 1) / kGranularity;
+    }
+
+    void AddSlab(std::size_t cls) {
+        auto* slab = static_cast<Slab*>(::operator new(kSlabSize));
+        slab->next = slabs_;
+        slabs_ = slab;
+        // The tail of the previous slab is too short for a slot and is dropped.
+        cursor_[cls] = reinterpret_cast<char*>(slab + 1);
+        end_[cls] = reinterpret_cast<char*>(slab) + kSlabSize;
+    }
+};
+
+template <typename T>
+class PoolAllocator {
+    std::shared_ptr<PoolStorage> storage;
+
+public:
+    using value_type = T;
+
+    // Owns a fresh pool shared by this allocator and all of its copies.
+    PoolAllocator() : storage { std::make_shared<PoolStorage>() } {
+    }
+
+    // Uses an externally owned pool that must outlive the allocator.
+    explicit PoolAllocator(PoolStorage& storage) : storage { std::shared_ptr<PoolStorage>(), &storage } {
+    }
+
+    PoolAllocator(const PoolAllocator& other) noexcept = default;
+
+    // A moved-from allocator must stay usable and equal to the new one, so
+    // moving copies the pool reference.
+    PoolAllocator(PoolAllocator&& other) noexcept : storage { other.storage } {
+    }
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) noexcept : storage { other.storage } {
+    }
+
+    PoolAllocator& operator=(const PoolAllocator& other) noexcept = default;
+
+    PoolAllocator& operator=(PoolAllocator&& other) noexcept {
+        storage = other.storage;
+        return *this;
+    }
+
+    T* allocate(std::size_t sz) {
+        return static_cast<T*>(storage->allocate_raw(alignof(T), sizeof(T) * sz));
+    }
+
+    void deallocate(T* ptr, std::size_t sz) noexcept {
+        storage->deallocate_raw(ptr, alignof(T), sizeof(T) * sz);
+    }
+
+    template <typename U>
+    friend class PoolAllocator;
+
+    template <typename U>
+    struct rebind {
+        using other = PoolAllocator<U>;
+    };
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& other) const noexcept {
+        return storage.get() == other.storage.get();
+    }
+};
+
+#endif  // POOLALLOCATOR_H
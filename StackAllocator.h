@@ -1,63 +1,600 @@
 #ifndef STACKALLOCATOR_H
 #define STACKALLOCATOR_H
  
+#include <atomic>
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <cstddef>
 #include <type_traits>
 #include <iterator>
 #include <cstddef>
+#include <functional>
+#include <memory_resource>
+#include <new>
+#include <ostream>
+#include <vector>
+ 
+#include <sys/mman.h>
+#include <unistd.h>
+ 
+// Arena usage counters are compiled in only with -DSTACK_STORAGE_STATS;
+// otherwise every storage reports zeros and the counters take no space.
+#ifdef STACK_STORAGE_STATS
+inline constexpr bool kStackStorageStats = true;
+#else
+inline constexpr bool kStackStorageStats = false;
+#endif
+ 
+struct StackStorageStats {
+    std::size_t capacity = 0;
+    std::size_t bytes_requested = 0;
+    std::size_t padding_bytes = 0;
+    std::size_t allocations = 0;
+    std::size_t failed_allocations = 0;
+    std::size_t high_water_mark = 0;
+ 
+    void report(std::ostream& out) const {
+        out << "capacity: " << capacity << '\n'
+            << "high water mark: " << high_water_mark << '\n'
+            << "bytes requested: " << bytes_requested << '\n'
+            << "padding bytes: " << padding_bytes << '\n'
+            << "allocations: " << allocations << '\n'
+            << "failed allocations: " << failed_allocations << '\n';
+    }
+};
+ 
+template <typename Counter, bool Enabled = kStackStorageStats>
+class StackStorageCounters {
+    Counter bytes_requested { 0 };
+    Counter padding_bytes { 0 };
+    Counter allocations { 0 };
+    Counter failed_allocations { 0 };
+    Counter high_water_mark { 0 };
+ 
+    static void Add(std::size_t& counter, std::size_t value) noexcept {
+        counter += value;
+    }
+ 
+    static void Add(std::atomic<std::size_t>& counter, std::size_t value) noexcept {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    }
+ 
+    static void Max(std::size_t& counter, std::size_t value) noexcept {
+        if (counter < value) {
+            counter = value;
+        }
+    }
+ 
+    static void Max(std::atomic<std::size_t>& counter, std::size_t value) noexcept {
+        std::size_t current = counter.load(std::memory_order_relaxed);
+        while (current < value && !counter.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+ 
+public:
+    void OnRequest(std::size_t sz) noexcept {
+        Add(bytes_requested, sz);
+        Add(allocations, 1);
+    }
+ 
+    void OnFailure() noexcept {
+        Add(failed_allocations, 1);
+    }
+ 
+    void OnPadding(std::size_t padding) noexcept {
+        Add(padding_bytes, padding);
+    }
+ 
+    void OnReach(std::size_t offset) noexcept {
+        Max(high_water_mark, offset);
+    }
+ 
+    StackStorageStats stats(std::size_t capacity) const noexcept {
+        return { capacity,     bytes_requested,    padding_bytes,
+                 allocations,  failed_allocations, high_water_mark };
+    }
+};
+ 
+template <typename Counter>
+class StackStorageCounters<Counter, false> {
+public:
+    void OnRequest(std::size_t) noexcept {
+    }
+ 
+    void OnFailure() noexcept {
+    }
+ 
+    void OnPadding(std::size_t) noexcept {
+    }
+ 
+    void OnReach(std::size_t) noexcept {
+    }
+ 
+    StackStorageStats stats(std::size_t capacity) const noexcept {
+        return { capacity };
+    }
+};
+ 
+// Arenas and allocators whose memory is reclaimed all at once, by rewinding
+// the arena, declare bulk_release. Containers of trivially destructible
+// elements may then forget their nodes instead of freeing them one by one.
+template <typename T>
+inline constexpr bool kBulkRelease = requires { requires T::bulk_release; };
  
 template <std::size_t N>
 class StackStorage {
     char mem[N];
     char* root;
+    [[no_unique_address]] StackStorageCounters<std::size_t> counters;
  
 public:
-    StackStorage() noexcept : mem(), root { mem } {
+    static constexpr bool bulk_release = true;
+ 
+    StackStorage() noexcept : root { mem } {
     }
  
     StackStorage(const StackStorage&) = delete;
  
     void* allocate_raw(std::size_t st_mem, std::size_t sz) {
         size_t tmp = N - (root - mem);
-        if (std::align(st_mem, sz, reinterpret_cast<void*&>(root), tmp) == nullptr) return nullptr;
+        char* before = root;
+        if (std::align(st_mem, sz, reinterpret_cast<void*&>(root), tmp) == nullptr) {
+            counters.OnFailure();
+            return nullptr;
+        }
         root += sz;
+        counters.OnRequest(sz);
+        counters.OnPadding(root - sz - before);
+        counters.OnReach(root - mem);
         return root - sz;
     }
+ 
+    bool owns(const void* ptr) const noexcept {
+        return std::less_equal<const void*>()(mem, ptr) && std::less<const void*>()(ptr, mem + N);
+    }
+ 
+    // Cumulative over the lifetime of the arena, including across reset().
+    StackStorageStats stats() const noexcept {
+        return counters.stats(N);
+    }
+ 
+    // Rewinds the arena; everything allocated from it so far is released at once.
+    void reset() noexcept {
+        root = mem;
+    }
 };
  
-template <typename T, std::size_t N>
+// Arena that many threads may bump-allocate from at once; it is released as a
+// whole by reset(), which must not race with allocations. With a non-zero
+// chunk_size every thread carves small requests out of a private chunk of that
+// many bytes and only goes to the shared atomic offset for a new chunk. The
+// cached chunk is per thread and per N, so interleaving several storages of
+// the same N on one thread leaves the tail of the previous chunk unused.
+template <std::size_t N>
+class ConcurrentStackStorage {
+    char mem[N];
+    std::atomic<std::size_t> offset { 0 };
+    std::size_t chunk_size;
+    std::uint64_t generation;
+    [[no_unique_address]] StackStorageCounters<std::atomic<std::size_t>> counters;
+ 
+    struct LocalChunk {
+        std::uint64_t generation = 0;
+        char* cursor = nullptr;
+        char* end = nullptr;
+    };
+ 
+    static inline std::atomic<std::uint64_t> next_generation { 1 };
+ 
+    static std::uint64_t NextGeneration() noexcept {
+        return next_generation.fetch_add(1, std::memory_order_relaxed);
+    }
+ 
+    void* AllocateShared(std::size_t st_mem, std::size_t sz) noexcept {
+        const auto base = reinterpret_cast<std::uintptr_t>(mem);
+        std::size_t current = offset.load(std::memory_order_relaxed);
+        while (true) {
+            std::size_t aligned = ((base + current + st_mem - 1) & ~(st_mem - 1)) - base;
+            if (aligned > N || N - aligned < sz) {
+                return nullptr;
+            }
+            if (offset.compare_exchange_weak(current, aligned + sz, std::memory_order_relaxed)) {
+                counters.OnPadding(aligned - current);
+                counters.OnReach(aligned + sz);
+                return mem + aligned;
+            }
+        }
+    }
+ 
+    void* AllocateFromChunk(std::size_t st_mem, std::size_t sz) noexcept {
+        thread_local LocalChunk chunk;
+        if (chunk.generation == generation) {
+            void* ptr = chunk.cursor;
+            std::size_t space = chunk.end - chunk.cursor;
+            if (std::align(st_mem, sz, ptr, space) != nullptr) {
+                counters.OnPadding(static_cast<char*>(ptr) - chunk.cursor);
+                chunk.cursor = static_cast<char*>(ptr) + sz;
+                return ptr;
+            }
+        }
+        if (sz > chunk_size / 2) {
+            return AllocateShared(st_mem, sz);
+        }
+        auto* fresh = static_cast<char*>(AllocateShared(alignof(std::max_align_t), chunk_size));
+        if (fresh == nullptr) {
+            return AllocateShared(st_mem, sz);
+        }
+        chunk = { generation, fresh, fresh + chunk_size };
+        void* ptr = chunk.cursor;
+        std::size_t space = chunk_size;
+        if (std::align(st_mem, sz, ptr, space) == nullptr) {
+            // Over-aligned requests may not fit in a chunk that is only
+            // max_align_t aligned; the chunk stays cached for later ones.
+            return AllocateShared(st_mem, sz);
+        }
+        counters.OnPadding(static_cast<char*>(ptr) - chunk.cursor);
+        chunk.cursor = static_cast<char*>(ptr) + sz;
+        return ptr;
+    }
+ 
+public:
+    static constexpr bool bulk_release = true;
+ 
+    explicit ConcurrentStackStorage(std::size_t chunk_size = 0) noexcept
+        : chunk_size { chunk_size }, generation { NextGeneration() } {
+    }
+ 
+    ConcurrentStackStorage(const ConcurrentStackStorage&) = delete;
+ 
+    void* allocate_raw(std::size_t st_mem, std::size_t sz) noexcept {
+        void* ptr = chunk_size == 0 ? AllocateShared(st_mem, sz) : AllocateFromChunk(st_mem, sz);
+        if (ptr == nullptr) {
+            counters.OnFailure();
+        }
+        else {
+            counters.OnRequest(sz);
+        }
+        return ptr;
+    }
+ 
+    bool owns(const void* ptr) const noexcept {
+        return std::less_equal<const void*>()(mem, ptr) && std::less<const void*>()(ptr, mem + N);
+    }
+ 
+    // With chunking the high water mark counts whole chunks handed to threads.
+    StackStorageStats stats() const noexcept {
+        return counters.stats(N);
+    }
+ 
+    // Chunks cached by threads belong to the old generation and are dropped.
+    void reset() noexcept {
+        offset.store(0, std::memory_order_relaxed);
+        generation = NextGeneration();
+    }
+};
+ 
+// Arena whose size is chosen at runtime. The whole range is reserved up front
+// with mmap and the kernel commits pages on first touch, so creating a large
+// arena costs neither a memset nor resident memory. reset() hands the pages
+// used so far back to the kernel.
+class MmapStackStorage {
+    char* mem;
+    char* root;
+    std::size_t size;
+    bool huge = false;
+    [[no_unique_address]] StackStorageCounters<std::size_t> counters;
+ 
+    static std::size_t PageSize() noexcept {
+        static const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        return page;
+    }
+ 
+public:
+    static constexpr bool bulk_release = true;
+ 
+    // huge_pages asks for transparent huge pages; explicit MAP_HUGETLB pages
+    // are not used since they cannot be committed lazily without risking
+    // SIGBUS on first touch. Kernels without THP refuse the advice, which
+    // huge_pages() then reports.
+    explicit MmapStackStorage(std::size_t size, bool huge_pages = false) : size { size } {
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (ptr == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        if (huge_pages) {
+            huge = madvise(ptr, size, MADV_HUGEPAGE) == 0;
+        }
+        mem = static_cast<char*>(ptr);
+        root = mem;
+    }
+ 
+    MmapStackStorage(const MmapStackStorage&) = delete;
+ 
+    ~MmapStackStorage() {
+        munmap(mem, size);
+    }
+ 
+    void* allocate_raw(std::size_t st_mem, std::size_t sz) {
+        size_t tmp = size - (root - mem);
+        char* before = root;
+        if (std::align(st_mem, sz, reinterpret_cast<void*&>(root), tmp) == nullptr) {
+            counters.OnFailure();
+            return nullptr;
+        }
+        root += sz;
+        counters.OnRequest(sz);
+        counters.OnPadding(root - sz - before);
+        counters.OnReach(root - mem);
+        return root - sz;
+    }
+ 
+    // Returns false when the kernel kept the pages, as it does for locked
+    // ones; they stay committed and are reused. The arena is rewound either way.
+    bool reset() noexcept {
+        std::size_t used = (root - mem + PageSize() - 1) & ~(PageSize() - 1);
+        used = used < size ? used : size;
+        root = mem;
+        return used == 0 || madvise(mem, used, MADV_DONTNEED) == 0;
+    }
+ 
+    std::size_t capacity() const noexcept {
+        return size;
+    }
+ 
+    // Whether the kernel accepted the request for transparent huge pages.
+    bool huge_pages() const noexcept {
+        return huge;
+    }
+ 
+    bool owns(const void* ptr) const noexcept {
+        return std::less_equal<const void*>()(mem, ptr) && std::less<const void*>()(ptr, mem + size);
+    }
+ 
+    StackStorageStats stats() const noexcept {
+        return counters.stats(size);
+    }
+};
+ 
+// Exposes an arena to std::pmr containers. Requests the arena cannot satisfy
+// go to the upstream resource, and only those are ever deallocated; memory
+// carved from the arena is released by resetting the storage. A StackAllocator
+// built from the resource shares the same arena, so List and pmr containers
+// can live in one request-scoped storage.
+template <typename Storage>
+class StackMemoryResource : public std::pmr::memory_resource {
+    Storage* storage_;
+    std::pmr::memory_resource* upstream_;
+ 
+public:
+    explicit StackMemoryResource(Storage& storage,
+                                 std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) noexcept
+        : storage_ { &storage }, upstream_ { upstream } {
+    }
+ 
+    StackMemoryResource(const StackMemoryResource&) = delete;
+ 
+    Storage& storage() const noexcept {
+        return *storage_;
+    }
+ 
+    std::pmr::memory_resource* upstream_resource() const noexcept {
+        return upstream_;
+    }
+ 
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        void* ptr = storage_->allocate_raw(alignment, bytes);
+        if (ptr == nullptr) {
+            ptr = upstream_->allocate(bytes, alignment);
+        }
+        return ptr;
+    }
+ 
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override {
+        if (!storage_->owns(ptr)) {
+            upstream_->deallocate(ptr, bytes, alignment);
+        }
+    }
+ 
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+ 
+// Per-thread cache of idle arenas backing default-constructed StackAllocators.
+// An arena is shared by an allocator and all of its (rebound) copies; the last
+// of them to go away rewinds it and hands it back to the pool of the thread it
+// dies on. Only acquire/release touch the pool, allocate never does. Once a
+// thread's pool has been destroyed, which may happen before objects with
+// static storage duration go away, its arenas are created and deleted
+// directly.
+template <typename Storage>
+class StackStoragePool {
+    struct Local;
+ 
+    static inline thread_local bool torn_down_ = false;
+ 
+public:
+    struct Arena {
+        Storage storage;
+        std::atomic<std::size_t> owners { 0 };
+    };
+ 
+    static constexpr std::size_t kMaxIdle = 4;
+ 
+    StackStoragePool() = default;
+ 
+    StackStoragePool(const StackStoragePool&) = delete;
+ 
+    StackStoragePool& operator=(const StackStoragePool&) = delete;
+ 
+    ~StackStoragePool() {
+        for (Arena* arena : idle_) {
+            delete arena;
+        }
+    }
+ 
+    static StackStoragePool& local() {
+        thread_local Local pool;
+        return pool;
+    }
+ 
+    static Arena* acquire_local() {
+        if (!torn_down_) {
+            return local().acquire();
+        }
+        Arena* arena = new Arena;
+        arena->owners.store(1, std::memory_order_relaxed);
+        return arena;
+    }
+ 
+    static void release_local(Arena* arena) noexcept {
+        if (!torn_down_) {
+            local().release(arena);
+            return;
+        }
+        delete arena;
+    }
+ 
+    Arena* acquire() {
+        Arena* arena = nullptr;
+        if (idle_.empty()) {
+            // Default-initialized: value-initialization would zero the whole
+            // buffer of a StackStorage.
+            arena = new Arena;
+        }
+        else {
+            arena = idle_.back();
+            idle_.pop_back();
+        }
+        arena->owners.store(1, std::memory_order_relaxed);
+        return arena;
+    }
+ 
+    void release(Arena* arena) noexcept {
+        arena->storage.reset();
+        if (idle_.size() >= kMaxIdle) {
+            delete arena;
+            return;
+        }
+        try {
+            idle_.push_back(arena);
+        }
+        catch (...) {
+            delete arena;
+        }
+    }
+ 
+    std::size_t idle() const noexcept {
+        return idle_.size();
+    }
+ 
+private:
+    std::vector<Arena*> idle_;
+};
+ 
+template <typename Storage>
+struct StackStoragePool<Storage>::Local : StackStoragePool {
+    ~Local() {
+        torn_down_ = true;
+    }
+};
+ 
+template <typename T, std::size_t N, typename Storage = StackStorage<N>>
 class StackAllocator {
-    StackStorage<N>* storage;
+    using Arena = typename StackStoragePool<Storage>::Arena;
+ 
+    Storage* storage;
+    Arena* pooled = nullptr;
+    std::pmr::memory_resource* upstream = nullptr;
+ 
+    void Retain() const noexcept {
+        if (pooled != nullptr) {
+            pooled->owners.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+ 
+    void Release() noexcept {
+        if (pooled != nullptr && pooled->owners.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            StackStoragePool<Storage>::release_local(pooled);
+        }
+    }
  
 public:
     using value_type = T;
  
-    StackAllocator() {
-        storage = new StackStorage<N>();
+    static constexpr bool bulk_release = kBulkRelease<Storage>;
+ 
+    // Draws an arena from the calling thread's StackStoragePool.
+    StackAllocator()
+        requires std::is_default_constructible_v<Storage>
+    : pooled { StackStoragePool<Storage>::acquire_local() } {
+        storage = &pooled->storage;
+    }
+ 
+    explicit StackAllocator(Storage& storage) : storage { &storage } {
+    }
+ 
+    // Shares the resource's arena and falls back to its upstream like it does.
+    explicit StackAllocator(const StackMemoryResource<Storage>& resource)
+        : storage { &resource.storage() }, upstream { resource.upstream_resource() } {
     }
  
-    explicit StackAllocator(StackStorage<N>& storage) : storage { &storage } {
+    StackAllocator(const StackAllocator& other) noexcept
+        : storage { other.storage }, pooled { other.pooled }, upstream { other.upstream } {
+        Retain();
     }
  
     template <typename U>
-    StackAllocator(const StackAllocator<U, N>& other) : storage { other.storage } {
+    StackAllocator(const StackAllocator<U, N, Storage>& other) noexcept
+        : storage { other.storage }, pooled { other.pooled }, upstream { other.upstream } {
+        Retain();
+    }
+ 
+    StackAllocator& operator=(const StackAllocator& other) noexcept {
+        if (pooled != other.pooled) {
+            other.Retain();
+            Release();
+            pooled = other.pooled;
+        }
+        storage = other.storage;
+        upstream = other.upstream;
+        return *this;
+    }
+ 
+    ~StackAllocator() {
+        Release();
     }
  
     T* allocate(std::size_t sz) {
-        return reinterpret_cast<T*>(storage->allocate_raw(alignof(T), sizeof(T) * sz));
+        void* ptr = storage->allocate_raw(alignof(T), sizeof(T) * sz);
+        if (ptr == nullptr) {
+            if (upstream == nullptr) {
+                throw std::bad_alloc();
+            }
+            ptr = upstream->allocate(sizeof(T) * sz, alignof(T));
+        }
+        return reinterpret_cast<T*>(ptr);
+    }
+ 
+    void deallocate(T* ptr, std::size_t sz) noexcept {
+        if (upstream != nullptr && !storage->owns(ptr)) {
+            upstream->deallocate(ptr, sizeof(T) * sz, alignof(T));
+        }
     }
  
-    void deallocate(T*, std::size_t) noexcept {
+    // Blocks taken from an upstream resource still need deallocate().
+    bool releases_in_bulk() const noexcept {
+        return upstream == nullptr;
     }
  
-    template <typename U, std::size_t M>
+    template <typename U, std::size_t M, typename S>
     friend class StackAllocator;
  
     template <typename U>
     struct rebind {
-        using other = StackAllocator<U, N>;
+        using other = StackAllocator<U, N, Storage>;
     };
  
     bool operator==(const StackAllocator&) const = default;
@@ -65,23 +602,31 @@ public:
     bool operator!=(const StackAllocator&) const = default;
 };
  
+template <typename T>
+using MmapStackAllocator = StackAllocator<T, 0, MmapStackStorage>;
+ 
+// Link part of every List node; IntrusiveListHook embeds the same links.
+struct ListBaseNode {
+    ListBaseNode* previous;
+    ListBaseNode* next;
+};
+ 
 template <typename T, typename Alloc = std::allocator<T> >
 struct List {
 private:
-    struct BaseNode {
-        BaseNode* previous;
-        BaseNode* next;
-    };
+    using BaseNode = ListBaseNode;
  
     struct Node : BaseNode {
         T value;
  
-        Node(const T& value_) : value(value_) {
+        template <typename... Args>
+        Node(Args&&... args) : value(std::forward<Args>(args)...) {
         }
- 
-        Node() = default;
     };
  
+    static constexpr std::size_t kChunkNodes = 64;
+    static constexpr std::size_t kPrefetchDistance = 4;
+ 
     template <bool IsConst>
     struct Iterator {
     public:
@@ -94,11 +639,13 @@ private:
         using base_node_type = std::conditional_t<IsConst, BaseNode*, BaseNode*>;
  
     private:
-        BaseNode* now_node;
+        BaseNode* now_node = nullptr;
  
     public:
         friend struct List;
  
+        Iterator() = default;
+ 
         Iterator(base_node_type node) : now_node(node) {
         }
  
@@ -114,11 +661,11 @@ private:
             return *this;
         }
  
-        reference operator*() {
+        reference operator*() const {
             return static_cast<node_type>(now_node)->value;
         }
  
-        pointer operator->() {
+        pointer operator->() const {
             return &(*(*this));
         }
  
@@ -153,7 +700,7 @@ private:
         bool operator!=(const Iterator& other) const = default;
     };
  
-    BaseNode* fake_node;
+    BaseNode fake_node;
     std::size_t size_ = 0;
  
 public:
@@ -174,11 +721,12 @@ public:
         return size_;
     }
  
-    iterator insert(const_iterator pos, const T& value) {
+    template <typename... Args>
+    iterator emplace(const_iterator pos, Args&&... args) {
         Node* new_mem = nullptr;
         new_mem = node_traits::allocate(alloc_, 1);
         try {
-            node_traits::construct(alloc_, new_mem, value);
+            node_traits::construct(alloc_, new_mem, std::forward<Args>(args)...);
         }
         catch (...) {
             node_traits::deallocate(alloc_, new_mem, 1);
@@ -193,20 +741,50 @@ public:
         return iterator(new_mem);
     }
  
+    iterator insert(const_iterator pos, const T& value) {
+        return emplace(pos, value);
+    }
+ 
+    iterator insert(const_iterator pos, T&& value) {
+        return emplace(pos, std::move(value));
+    }
+ 
+    // Nodes for forward ranges are built in order. Only allocators that
+    // release in bulk get them in runs of consecutive slots; see
+    // EmplaceChunked().
+    template <std::input_iterator InputIt>
+    iterator insert(const_iterator pos, InputIt first, InputIt last) {
+        if constexpr (std::forward_iterator<InputIt>) {
+            return EmplaceChunked(pos, std::distance(first, last), [&](Node* node) {
+                node_traits::construct(alloc_, node, *first);
+                ++first;
+            });
+        }
+        else {
+            List tail(alloc_);
+            for (; first != last; ++first) {
+                tail.emplace_back(*first);
+            }
+            iterator result = tail.begin();
+            splice(pos, tail);
+            return result;
+        }
+    }
+ 
     iterator begin() {
-        return fake_node->next;
+        return fake_node.next;
     }
  
     const_iterator begin() const {
-        return fake_node->next;
+        return fake_node.next;
     }
  
     iterator end() {
-        return iterator(fake_node);
+        return iterator(Sentinel());
     }
  
     const_iterator end() const {
-        return const_iterator(fake_node);
+        return const_iterator(Sentinel());
     }
  
     reverse_iterator rbegin() {
@@ -245,8 +823,7 @@ public:
         pos.now_node->previous->next = pos.now_node->next;
         pos.now_node->next->previous = pos.now_node->previous;
         BaseNode* new_pos = pos.now_node->next;
-        node_traits::destroy(alloc_, static_cast<Node*>(pos.now_node));
-        node_traits::deallocate(alloc_, static_cast<Node*>(pos.now_node), 1);
+        DestroyNode(static_cast<Node*>(pos.now_node));
         size_--;
         return new_pos;
     }
@@ -256,7 +833,16 @@ public:
     }
  
     void push_back(const T& value) {
-        insert(end(), value);
+        emplace(end(), value);
+    }
+ 
+    void push_back(T&& value) {
+        emplace(end(), std::move(value));
+    }
+ 
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        return *emplace(end(), std::forward<Args>(args)...);
     }
  
     void pop_front() {
@@ -264,49 +850,281 @@ public:
     }
  
     void push_front(const T& value) {
-        insert(begin(), value);
+        emplace(begin(), value);
     }
  
-    void clear() {
-        while (size() > 0) {
+    void push_front(T&& value) {
+        emplace(begin(), std::move(value));
+    }
+ 
+    template <typename... Args>
+    T& emplace_front(Args&&... args) {
+        return *emplace(begin(), std::forward<Args>(args)...);
+    }
+ 
+    // The splice overloads relink nodes and never allocate; both lists must
+    // use equal allocators. Iterators to moved elements stay valid and now
+    // refer into *this.
+    void splice(const_iterator pos, List& other) noexcept {
+        if (&other == this || other.size_ == 0) {
+            return;
+        }
+        Transfer(pos.now_node, other.fake_node.next, other.Sentinel());
+        size_ += other.size_;
+        other.size_ = 0;
+    }
+ 
+    void splice(const_iterator pos, List&& other) noexcept {
+        splice(pos, other);
+    }
+ 
+    void splice(const_iterator pos, List& other, const_iterator it) noexcept {
+        BaseNode* next = it.now_node->next;
+        if (pos.now_node == it.now_node || pos.now_node == next) {
+            return;
+        }
+        Transfer(pos.now_node, it.now_node, next);
+        ++size_;
+        --other.size_;
+    }
+ 
+    void splice(const_iterator pos, List&& other, const_iterator it) noexcept {
+        splice(pos, other, it);
+    }
+ 
+    // Linear in the length of the range when other is a different list.
+    void splice(const_iterator pos, List& other, const_iterator first, const_iterator last) noexcept {
+        if (first == last) {
+            return;
+        }
+        if (&other != this) {
+            std::size_t count = std::distance(first, last);
+            size_ += count;
+            other.size_ -= count;
+        }
+        Transfer(pos.now_node, first.now_node, last.now_node);
+    }
+ 
+    void splice(const_iterator pos, List&& other, const_iterator first, const_iterator last) noexcept {
+        splice(pos, other, first, last);
+    }
+ 
+    // Moves the elements, in list order, into freshly allocated nodes and
+    // frees the old ones, undoing the scatter left by long insert and erase
+    // churn. Returns false, and does nothing, unless the allocator releases
+    // in bulk: only then are the new nodes taken in runs of consecutive slots
+    // (see EmplaceChunked()), and a heap list would just be rebuilt node by
+    // node. The old nodes of an arena list are reclaimed only when the arena
+    // is rewound, so every compact() uses another size() nodes of it.
+    //
+    // Invalidates every iterator, pointer and reference to the elements. All
+    // new nodes are allocated before any element is moved, and if T's move
+    // constructor may throw, elements are copied instead, so the list is
+    // unchanged when an allocation or a copy throws.
+    bool compact() {
+        std::size_t count = size_;
+        if (count < 2 || !ReleasesInBulk()) {
+            return false;
+        }
+        // Every node is allocated before the first element is moved, so
+        // running out of memory cannot leave moved-from elements behind.
+        BaseNode* slots = AllocateSlots(count);
+        BaseNode* source = fake_node.next;
+        EmplaceChunked(end(), count, [this, &source](Node* node) {
+            node_traits::construct(alloc_, node, std::move_if_noexcept(Value(source)));
+            source = source->next;
+        }, slots);
+        while (count-- > 0) {
             pop_front();
         }
+        return true;
     }
  
-    List() {
-        size_ = 0;
-        fake_node = new BaseNode();
-        fake_node->next = fake_node;
-        fake_node->previous = fake_node;
+    // Calls f on every element while prefetching the node distance steps
+    // ahead, so the pointer chase overlaps the work done by f.
+    template <typename Function>
+    void for_each_prefetched(Function f, std::size_t distance = kPrefetchDistance) {
+        BaseNode* ahead = fake_node.next;
+        for (std::size_t i = 0; i < distance && ahead != &fake_node; ++i) {
+            ahead = ahead->next;
+            Prefetch(ahead);
+        }
+        for (BaseNode* node = fake_node.next; node != &fake_node; node = node->next) {
+            if (ahead != &fake_node) {
+                ahead = ahead->next;
+                Prefetch(ahead);
+            }
+            f(Value(node));
+        }
     }
  
-    explicit List(Alloc alloc) : List() {
-        alloc_ = alloc;
+    template <typename Function>
+    void for_each_prefetched(Function f, std::size_t distance = kPrefetchDistance) const {
+        const_cast<List*>(this)->for_each_prefetched([&f](const T& value) {
+            f(value);
+        }, distance);
     }
  
-    explicit List(size_t size) : List() {
+    // The operations below only relink nodes: they never allocate or copy T,
+    // and iterators stay valid and keep referring to the same elements.
+    void reverse() noexcept {
+        BaseNode* node = &fake_node;
+        do {
+            std::swap(node->previous, node->next);
+            node = node->previous;
+        } while (node != &fake_node);
+    }
+ 
+    // Stable; both lists must be sorted by comp and use equal allocators.
+    template <typename Compare = std::less<>>
+    void merge(List& other, Compare comp = Compare()) {
+        if (&other == this) {
+            return;
+        }
+        BaseNode* first = fake_node.next;
+        BaseNode* second = other.fake_node.next;
+        while (first != &fake_node && second != &other.fake_node) {
+            if (comp(Value(second), Value(first))) {
+                BaseNode* next = second->next;
+                Transfer(first, second, next);
+                second = next;
+                ++size_;
+                --other.size_;
+            }
+            else {
+                first = first->next;
+            }
+        }
+        splice(end(), other);
+    }
+ 
+    template <typename Compare = std::less<>>
+    void merge(List&& other, Compare comp = Compare()) {
+        merge(other, comp);
+    }
+ 
+    // Stable bottom-up merge sort. If comp throws, every element is still in
+    // the list, in unspecified order.
+    template <typename Compare = std::less<>>
+    void sort(Compare comp = Compare()) {
+        if (size_ < 2) {
+            return;
+        }
+        constexpr std::size_t kBins = 64;
+        BaseNode* bins[kBins] = {};
+        BaseNode* carry = nullptr;
+        BaseNode* rest = fake_node.next;
+        fake_node.previous->next = nullptr;
         try {
-            while (size--) {
-                insert(end());
+            while (rest != nullptr) {
+                carry = rest;
+                rest = rest->next;
+                carry->next = nullptr;
+                std::size_t i = 0;
+                for (; bins[i] != nullptr; ++i) {
+                    MergeChains(bins[i], carry, comp);
+                    carry = bins[i];
+                    bins[i] = nullptr;
+                }
+                bins[i] = carry;
+                carry = nullptr;
+            }
+            for (std::size_t i = 0; i < kBins; ++i) {
+                if (bins[i] == nullptr) {
+                    continue;
+                }
+                if (carry != nullptr) {
+                    MergeChains(bins[i], carry, comp);
+                }
+                carry = bins[i];
+                bins[i] = nullptr;
             }
         }
         catch (...) {
-            clear();
+            BaseNode* tail = RelinkChain(&fake_node, rest);
+            tail = RelinkChain(tail, carry);
+            for (BaseNode* bin : bins) {
+                tail = RelinkChain(tail, bin);
+            }
+            tail->next = &fake_node;
+            fake_node.previous = tail;
             throw;
         }
+        BaseNode* tail = RelinkChain(&fake_node, carry);
+        tail->next = &fake_node;
+        fake_node.previous = tail;
     }
  
-    List(size_t size, Alloc alloc) : List() {
-        alloc_ = alloc;
-        try {
-            while (size--) {
-                insert(end());
+    template <typename Predicate>
+    std::size_t remove_if(Predicate pred) {
+        std::size_t removed = 0;
+        for (auto it = begin(); it != end();) {
+            if (pred(*it)) {
+                it = erase(it);
+                ++removed;
+            }
+            else {
+                ++it;
             }
         }
-        catch (...) {
-            clear();
-            throw;
+        return removed;
+    }
+ 
+    std::size_t remove(const T& value) {
+        return remove_if([&value](const T& item) {
+            return item == value;
+        });
+    }
+ 
+    // Keeps the first element of every run of consecutive equal elements.
+    template <typename BinaryPredicate = std::equal_to<>>
+    std::size_t unique(BinaryPredicate pred = BinaryPredicate()) {
+        std::size_t removed = 0;
+        if (size_ == 0) {
+            return removed;
+        }
+        for (auto kept = begin(), it = std::next(kept); it != end();) {
+            if (pred(*kept, *it)) {
+                it = erase(it);
+                ++removed;
+            }
+            else {
+                kept = it++;
+            }
         }
+        return removed;
+    }
+ 
+    // O(1) when the allocator releases in bulk and T is trivially destructible:
+    // the nodes are dropped and come back when the arena is rewound.
+    void clear() {
+        if (CanDropNodes()) {
+            fake_node.next = &fake_node;
+            fake_node.previous = &fake_node;
+            size_ = 0;
+            return;
+        }
+        while (size() > 0) {
+            pop_front();
+        }
+    }
+ 
+    List() : List(Alloc()) {
+    }
+ 
+    explicit List(Alloc alloc) : alloc_(alloc) {
+        size_ = 0;
+        fake_node.next = &fake_node;
+        fake_node.previous = &fake_node;
+    }
+ 
+    explicit List(size_t size) : List(size, Alloc()) {
+    }
+ 
+    List(size_t size, Alloc alloc) : List(alloc) {
+        EmplaceChunked(end(), size, [this](Node* node) {
+            node_traits::construct(alloc_, node);
+        });
     }
  
     ~List() {
@@ -317,22 +1135,13 @@ public:
     }
  
     List(size_t n, const T& value, Alloc alloc_) : List(alloc_) {
-        while (size() < n) {
-            push_back(value);
-        }
+        EmplaceChunked(end(), n, [this, &value](Node* node) {
+            node_traits::construct(this->alloc_, node, value);
+        });
     }
  
     List(const List& other) : List(node_traits::select_on_container_copy_construction(other.alloc_)) {
-        // alloc_ = other.alloc_;
-        try {
-            for (auto it = other.begin(); it != other.end(); ++it) {
-                push_back(*it);
-            }
-        }
-        catch (...) {
-            clear();
-            throw;
-        }
+        insert(end(), other.begin(), other.end());
     }
  
     List& operator=(const List& other) {
@@ -354,34 +1163,262 @@ public:
         return *this;
     }
  
+    List(List&& other) noexcept : alloc_(std::move(other.alloc_)) {
+        TakeNodes(other);
+    }
+ 
+    // Steals the nodes unless the allocators differ and do not propagate, in
+    // which case the elements are moved one by one into this list's nodes.
+    List& operator=(List&& other) noexcept(node_traits::propagate_on_container_move_assignment::value ||
+                                           node_traits::is_always_equal::value) {
+        if (this == &other) {
+            return *this;
+        }
+ 
+        clear();
+        if constexpr (node_traits::propagate_on_container_move_assignment::value) {
+            alloc_ = std::move(other.alloc_);
+        }
+        else if constexpr (!node_traits::is_always_equal::value) {
+            if (alloc_ != other.alloc_) {
+                for (auto it = other.begin(); it != other.end(); ++it) {
+                    emplace_back(std::move(*it));
+                }
+                other.clear();
+                return *this;
+            }
+        }
+        TakeNodes(other);
+        return *this;
+    }
+ 
     Alloc get_allocator() const {
         return alloc_;
     }
  
 private:
-    void Swap(List& other) {
-        std::swap(fake_node, other.fake_node);
-        std::swap(size_, other.size_);
-        std::swap(alloc_, other.alloc_);
+    BaseNode* Sentinel() const noexcept {
+        return const_cast<BaseNode*>(&fake_node);
     }
  
-    iterator insert(iterator pos) {
-        Node* new_mem = nullptr;
-        new_mem = node_traits::allocate(alloc_, 1);
+    // Points the neighbours of a sentinel that was copied bytewise back at it.
+    void FixSentinel() noexcept {
+        if (size_ == 0) {
+            fake_node.next = &fake_node;
+            fake_node.previous = &fake_node;
+            return;
+        }
+        fake_node.next->previous = &fake_node;
+        fake_node.previous->next = &fake_node;
+    }
+ 
+    void DestroyNode(Node* node) noexcept {
+        node_traits::destroy(alloc_, node);
+        node_traits::deallocate(alloc_, node, 1);
+    }
+ 
+    // Builds count nodes with construct(node), in order, and links them in
+    // front of pos. Given reserved, a chain from AllocateSlots(), the nodes
+    // are taken from it; otherwise they are allocated here. If a construction
+    // throws the list is left as it was.
+    //
+    // Runs of up to kChunkNodes consecutive slots are taken per allocator call
+    // only when the allocator releases in bulk. A node from such a run can
+    // then be given back on its own, so nodes carry no record of how they were
+    // allocated. Any other allocator, std::allocator included, gets one
+    // allocate(1) per node: giving back a fully free run would need either a
+    // chunk pointer in every node or chunks shared by every list that nodes
+    // were spliced into. Heap lists that want adjacent nodes should use
+    // PoolAllocator, whose slabs hand out consecutive slots of one size class.
+    template <typename Construct>
+    iterator EmplaceChunked(const_iterator pos, std::size_t count, Construct construct,
+                            BaseNode* reserved = nullptr) {
+        const bool runs = ReleasesInBulk();
+        BaseNode chain { &chain, &chain };
         try {
-            node_traits::construct(alloc_, new_mem);
+            for (std::size_t built = 0; built < count;) {
+                std::size_t batch = 1;
+                Node* slots;
+                if (reserved != nullptr) {
+                    slots = SlotNode(reserved);
+                    reserved = reserved->next;
+                }
+                else {
+                    batch = runs ? std::min(count - built, kChunkNodes) : 1;
+                    slots = node_traits::allocate(alloc_, batch);
+                }
+                for (std::size_t i = 0; i < batch; ++i, ++built) {
+                    Node* node = slots + i;
+                    try {
+                        construct(node);
+                    }
+                    catch (...) {
+                        if (!runs) {
+                            node_traits::deallocate(alloc_, node, 1);
+                        }
+                        throw;
+                    }
+                    node->previous = chain.previous;
+                    node->next = &chain;
+                    chain.previous->next = node;
+                    chain.previous = node;
+                }
+            }
         }
         catch (...) {
-            node_traits::deallocate(alloc_, new_mem, 1);
+            FreeSlots(reserved);
+            while (chain.next != &chain) {
+                BaseNode* node = chain.next;
+                chain.next = node->next;
+                DestroyNode(static_cast<Node*>(node));
+            }
             throw;
         }
-        auto* new_base = static_cast<BaseNode*>(new_mem);
-        new_base->previous = pos.now_node->previous;
-        new_base->next = pos.now_node;
-        new_base->previous->next = new_base;
-        new_base->next->previous = new_base;
-        ++size_;
-        return iterator(new_mem);
+        if (count == 0) {
+            return pos.now_node;
+        }
+        BaseNode* first = chain.next;
+        Transfer(pos.now_node, chain.next, &chain);
+        size_ += count;
+        return first;
+    }
+ 
+    // Returns count raw node slots chained in order through their links,
+    // taken in runs like EmplaceChunked() does.
+    BaseNode* AllocateSlots(std::size_t count) {
+        const bool runs = ReleasesInBulk();
+        BaseNode head { nullptr, nullptr };
+        BaseNode* tail = &head;
+        try {
+            for (std::size_t allocated = 0; allocated < count;) {
+                std::size_t batch = runs ? std::min(count - allocated, kChunkNodes) : 1;
+                Node* run = node_traits::allocate(alloc_, batch);
+                for (std::size_t i = 0; i < batch; ++i, ++allocated) {
+                    tail->next = ::new (static_cast<void*>(run + i)) BaseNode { nullptr, nullptr };
+                    tail = tail->next;
+                }
+            }
+        }
+        catch (...) {
+            FreeSlots(head.next);
+            throw;
+        }
+        return head.next;
+    }
+ 
+    void FreeSlots(BaseNode* slots) noexcept {
+        while (slots != nullptr) {
+            BaseNode* next = slots->next;
+            node_traits::deallocate(alloc_, SlotNode(slots), 1);
+            slots = next;
+        }
+    }
+ 
+    static Node* SlotNode(BaseNode* slot) noexcept {
+        return static_cast<Node*>(static_cast<void*>(slot));
+    }
+ 
+    void TakeNodes(List& other) noexcept {
+        fake_node = other.fake_node;
+        size_ = other.size_;
+        FixSentinel();
+        other.size_ = 0;
+        other.FixSentinel();
+    }
+ 
+    // True when deallocate() gives nothing back and the memory returns when
+    // the arena is rewound.
+    bool ReleasesInBulk() const noexcept {
+        if constexpr (!kBulkRelease<node_alloc>) {
+            return false;
+        }
+        else if constexpr (requires { alloc_.releases_in_bulk(); }) {
+            return alloc_.releases_in_bulk();
+        }
+        else {
+            return true;
+        }
+    }
+ 
+    bool CanDropNodes() const noexcept {
+        return std::is_trivially_destructible_v<T> && ReleasesInBulk();
+    }
+ 
+    static void Prefetch(const BaseNode* node) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(node);
+#endif
+    }
+ 
+    static T& Value(BaseNode* node) noexcept {
+        return static_cast<Node*>(node)->value;
+    }
+ 
+    // Merges the null-terminated chain second into first; on exception first
+    // still holds every node of both chains.
+    template <typename Compare>
+    static void MergeChains(BaseNode*& first, BaseNode*& second, Compare& comp) {
+        BaseNode head { nullptr, nullptr };
+        BaseNode* tail = &head;
+        BaseNode* a = first;
+        BaseNode* b = second;
+        second = nullptr;
+        try {
+            while (a != nullptr && b != nullptr) {
+                if (comp(Value(b), Value(a))) {
+                    tail->next = b;
+                    tail = b;
+                    b = b->next;
+                }
+                else {
+                    tail->next = a;
+                    tail = a;
+                    a = a->next;
+                }
+            }
+        }
+        catch (...) {
+            tail->next = a;
+            while (tail->next != nullptr) {
+                tail = tail->next;
+            }
+            tail->next = b;
+            first = head.next;
+            throw;
+        }
+        tail->next = a != nullptr ? a : b;
+        first = head.next;
+    }
+ 
+    // Appends a null-terminated chain after tail, restoring previous links,
+    // and returns the new tail.
+    static BaseNode* RelinkChain(BaseNode* tail, BaseNode* chain) noexcept {
+        while (chain != nullptr) {
+            tail->next = chain;
+            chain->previous = tail;
+            tail = chain;
+            chain = chain->next;
+        }
+        return tail;
+    }
+ 
+    // Moves [first, last) in front of pos.
+    static void Transfer(BaseNode* pos, BaseNode* first, BaseNode* last) noexcept {
+        BaseNode* tail = last->previous;
+        first->previous->next = last;
+        last->previous = first->previous;
+        first->previous = pos->previous;
+        tail->next = pos;
+        pos->previous->next = first;
+        pos->previous = tail;
+    }
+ 
+    void Swap(List& other) {
+        std::swap(fake_node, other.fake_node);
+        std::swap(size_, other.size_);
+        std::swap(alloc_, other.alloc_);
+        FixSentinel();
+        other.FixSentinel();
     }
 };
  
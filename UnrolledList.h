@@ -0,0 +1,490 @@
+#ifndef UNROLLEDLIST_H
+#define UNROLLEDLIST_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "StackAllocator.h"
+
+// Doubly linked list whose nodes hold up to Capacity elements in a small
+// array. Inserting into a full node splits it in half, and an erase that leaves
+// a node less than half full borrows from or merges with a neighbour, so all
+// nodes except the ones being filled by push_back/push_front stay at least
+// half full. Elements are moved between slots, so T must be nothrow move
+// constructible.
+template <typename T, typename Alloc = std::allocator<T>,
+          std::size_t Capacity = std::max<std::size_t>(4, 240 / sizeof(T))>
+class UnrolledList {
+    static_assert(Capacity >= 2);
+    static_assert(std::is_nothrow_move_constructible_v<T>, "UnrolledList moves elements between nodes");
+
+    using BaseNode = ListBaseNode;
+
+    struct Node : BaseNode {
+        std::size_t count = 0;
+        alignas(T) unsigned char storage[sizeof(T) * Capacity];
+
+        T* slot(std::size_t index) noexcept {
+            return reinterpret_cast<T*>(storage) + index;
+        }
+    };
+
+    template <bool IsConst>
+    struct Iterator {
+    public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::bidirectional_iterator_tag;
+        using pointer = std::conditional_t<IsConst, const T*, T*>;
+        using reference = std::conditional_t<IsConst, const T&, T&>;
+
+    private:
+        BaseNode* now_node = nullptr;
+        std::size_t index = 0;
+
+    public:
+        friend class UnrolledList;
+
+        Iterator() = default;
+
+        Iterator(BaseNode* node, std::size_t index) : now_node(node), index(index) {
+        }
+
+        Iterator(const Iterator<false>& iterator)
+            requires(IsConst)
+        : Iterator(iterator.now_node, iterator.index) {
+        }
+
+        Iterator(const Iterator<IsConst>& iterator) = default;
+
+        Iterator& operator=(const Iterator<false>& iterator) {
+            now_node = iterator.now_node;
+            index = iterator.index;
+            return *this;
+        }
+
+        reference operator*() const {
+            return *static_cast<Node*>(now_node)->slot(index);
+        }
+
+        pointer operator->() const {
+            return &(*(*this));
+        }
+
+        Iterator& operator++() {
+            if (++index == static_cast<Node*>(now_node)->count) {
+                now_node = now_node->next;
+                index = 0;
+            }
+            return *this;
+        }
+
+        Iterator& operator--() {
+            if (index == 0) {
+                now_node = now_node->previous;
+                index = static_cast<Node*>(now_node)->count;
+            }
+            --index;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        Iterator operator--(int) {
+            Iterator tmp = *this;
+            --*this;
+            return tmp;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return other.now_node == now_node && other.index == index;
+        }
+
+        bool operator!=(const Iterator& other) const = default;
+    };
+
+    BaseNode fake_node;
+    std::size_t size_ = 0;
+
+public:
+    using node_alloc = std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+    using node_traits = std::allocator_traits<node_alloc>;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+    using pointer = T*;
+    using const_pointer = const T*;
+    using reference = T&;
+    using const_reference = const T&;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using difference_type = std::ptrdiff_t;
+    [[no_unique_address]] node_alloc alloc_;
+
+    static constexpr std::size_t kNodeCapacity = Capacity;
+
+    UnrolledList() : UnrolledList(Alloc()) {
+    }
+
+    explicit UnrolledList(Alloc alloc) : alloc_(alloc) {
+        fake_node.next = &fake_node;
+        fake_node.previous = &fake_node;
+    }
+
+    UnrolledList(std::size_t count, const T& value, Alloc alloc = Alloc()) : UnrolledList(alloc) {
+        while (size_ < count) {
+            push_back(value);
+        }
+    }
+
+    UnrolledList(const UnrolledList& other)
+        : UnrolledList(node_traits::select_on_container_copy_construction(other.alloc_)) {
+        for (const T& value : other) {
+            push_back(value);
+        }
+    }
+
+    UnrolledList(UnrolledList&& other) noexcept : alloc_(std::move(other.alloc_)) {
+        TakeNodes(other);
+    }
+
+    UnrolledList& operator=(const UnrolledList& other) {
+        if (this == &other) {
+            return *this;
+        }
+        clear();
+        if constexpr (node_traits::propagate_on_container_copy_assignment::value) {
+            alloc_ = other.alloc_;
+        }
+        for (const T& value : other) {
+            push_back(value);
+        }
+        return *this;
+    }
+
+    UnrolledList& operator=(UnrolledList&& other) noexcept(
+        node_traits::propagate_on_container_move_assignment::value || node_traits::is_always_equal::value) {
+        if (this == &other) {
+            return *this;
+        }
+
+        clear();
+        if constexpr (node_traits::propagate_on_container_move_assignment::value) {
+            alloc_ = std::move(other.alloc_);
+        }
+        else if constexpr (!node_traits::is_always_equal::value) {
+            if (alloc_ != other.alloc_) {
+                for (T& value : other) {
+                    push_back(std::move(value));
+                }
+                other.clear();
+                return *this;
+            }
+        }
+        TakeNodes(other);
+        return *this;
+    }
+
+    ~UnrolledList() {
+        clear();
+    }
+
+    std::size_t size() const {
+        return size_;
+    }
+
+    Alloc get_allocator() const {
+        return alloc_;
+    }
+
+    iterator begin() {
+        return iterator(fake_node.next, 0);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(fake_node.next, 0);
+    }
+
+    iterator end() {
+        return iterator(Sentinel(), 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(Sentinel(), 0);
+    }
+
+    reverse_iterator rbegin() {
+        return std::reverse_iterator(end());
+    }
+
+    const_reverse_iterator rbegin() const {
+        return std::reverse_iterator(end());
+    }
+
+    reverse_iterator rend() {
+        return std::reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rend() const {
+        return std::reverse_iterator(begin());
+    }
+
+    const_iterator cbegin() const {
+        return begin();
+    }
+
+    const_iterator cend() const {
+        return end();
+    }
+
+    const_reverse_iterator crbegin() const {
+        return rbegin();
+    }
+
+    const_reverse_iterator crend() const {
+        return rend();
+    }
+
+    template <typename... Args>
+    iterator emplace(const_iterator pos, Args&&... args) {
+        if (pos.now_node == Sentinel()) {
+            if (size_ != 0 && Last()->count < Capacity) {
+                return ConstructAt(Last(), Last()->count, std::forward<Args>(args)...);
+            }
+            Node* node = NewNodeAfter(fake_node.previous);
+            try {
+                return ConstructAt(node, 0, std::forward<Args>(args)...);
+            }
+            catch (...) {
+                FreeNode(node);
+                throw;
+            }
+        }
+
+        auto* node = static_cast<Node*>(pos.now_node);
+        std::size_t index = pos.index;
+        if (node->count == Capacity) {
+            constexpr std::size_t kHalf = Capacity / 2;
+            Node* right = NewNodeAfter(node);
+            Relocate(node, kHalf, right, 0, Capacity - kHalf);
+            node->count = kHalf;
+            right->count = Capacity - kHalf;
+            if (index > kHalf) {
+                node = right;
+                index -= kHalf;
+            }
+        }
+        return ConstructAt(node, index, std::forward<Args>(args)...);
+    }
+
+    iterator insert(const_iterator pos, const T& value) {
+        return emplace(pos, value);
+    }
+
+    iterator insert(const_iterator pos, T&& value) {
+        return emplace(pos, std::move(value));
+    }
+
+    iterator erase(const_iterator pos) {
+        auto* node = static_cast<Node*>(pos.now_node);
+        std::size_t index = pos.index;
+        node_traits::destroy(alloc_, node->slot(index));
+        ShiftLeft(node, index + 1, 1);
+        --node->count;
+        --size_;
+        return Rebalance(node, index);
+    }
+
+    void push_back(const T& value) {
+        emplace(end(), value);
+    }
+
+    void push_back(T&& value) {
+        emplace(end(), std::move(value));
+    }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        return *emplace(end(), std::forward<Args>(args)...);
+    }
+
+    void pop_back() {
+        erase(--end());
+    }
+
+    void push_front(const T& value) {
+        emplace(begin(), value);
+    }
+
+    void push_front(T&& value) {
+        emplace(begin(), std::move(value));
+    }
+
+    template <typename... Args>
+    T& emplace_front(Args&&... args) {
+        return *emplace(begin(), std::forward<Args>(args)...);
+    }
+
+    void pop_front() {
+        erase(begin());
+    }
+
+    void clear() {
+        while (fake_node.next != &fake_node) {
+            auto* node = static_cast<Node*>(fake_node.next);
+            for (std::size_t i = 0; i < node->count; ++i) {
+                node_traits::destroy(alloc_, node->slot(i));
+            }
+            FreeNode(node);
+        }
+        size_ = 0;
+    }
+
+private:
+    BaseNode* Sentinel() const noexcept {
+        return const_cast<BaseNode*>(&fake_node);
+    }
+
+    Node* Last() const noexcept {
+        return static_cast<Node*>(fake_node.previous);
+    }
+
+    Node* RealNode(BaseNode* node) const noexcept {
+        return node == Sentinel() ? nullptr : static_cast<Node*>(node);
+    }
+
+    void TakeNodes(UnrolledList& other) noexcept {
+        fake_node = other.fake_node;
+        size_ = other.size_;
+        if (size_ == 0) {
+            fake_node.next = &fake_node;
+            fake_node.previous = &fake_node;
+        }
+        else {
+            fake_node.next->previous = &fake_node;
+            fake_node.previous->next = &fake_node;
+        }
+        other.size_ = 0;
+        other.fake_node.next = &other.fake_node;
+        other.fake_node.previous = &other.fake_node;
+    }
+
+    Node* NewNodeAfter(BaseNode* previous) {
+        Node* node = node_traits::allocate(alloc_, 1);
+        node_traits::construct(alloc_, node);
+        node->previous = previous;
+        node->next = previous->next;
+        previous->next->previous = node;
+        previous->next = node;
+        return node;
+    }
+
+    void FreeNode(Node* node) noexcept {
+        node->previous->next = node->next;
+        node->next->previous = node->previous;
+        node_traits::destroy(alloc_, node);
+        node_traits::deallocate(alloc_, node, 1);
+    }
+
+    // Moves count elements into raw slots of to and leaves raw slots in from.
+    void Relocate(Node* from, std::size_t from_index, Node* to, std::size_t to_index, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            node_traits::construct(alloc_, to->slot(to_index + i), std::move(*from->slot(from_index + i)));
+            node_traits::destroy(alloc_, from->slot(from_index + i));
+        }
+    }
+
+    // Moves the live elements [index, count) by shift slots towards the back.
+    void ShiftRight(Node* node, std::size_t index, std::size_t shift) {
+        for (std::size_t i = node->count; i-- > index;) {
+            Relocate(node, i, node, i + shift, 1);
+        }
+    }
+
+    // Moves the live elements [index, count) by shift slots towards the front.
+    void ShiftLeft(Node* node, std::size_t index, std::size_t shift) {
+        for (std::size_t i = index; i < node->count; ++i) {
+            Relocate(node, i, node, i - shift, 1);
+        }
+    }
+
+    template <typename... Args>
+    iterator ConstructAt(Node* node, std::size_t index, Args&&... args) {
+        if (index == node->count) {
+            node_traits::construct(alloc_, node->slot(index), std::forward<Args>(args)...);
+        }
+        else {
+            T value(std::forward<Args>(args)...);
+            ShiftRight(node, index, 1);
+            node_traits::construct(alloc_, node->slot(index), std::move(value));
+        }
+        ++node->count;
+        ++size_;
+        return iterator(node, index);
+    }
+
+    iterator Normalize(Node* node, std::size_t index) {
+        if (index < node->count) {
+            return iterator(node, index);
+        }
+        return iterator(node->next, 0);
+    }
+
+    // Restores the half-full invariant for node after an erase at index and
+    // returns an iterator to the element that followed the erased one.
+    iterator Rebalance(Node* node, std::size_t index) {
+        constexpr std::size_t kMin = Capacity / 2;
+        if (node->count >= kMin) {
+            return Normalize(node, index);
+        }
+
+        if (Node* next = RealNode(node->next)) {
+            if (node->count + next->count <= Capacity) {
+                Relocate(next, 0, node, node->count, next->count);
+                node->count += next->count;
+                next->count = 0;
+                FreeNode(next);
+            }
+            else {
+                std::size_t shift = (next->count - node->count) / 2;
+                Relocate(next, 0, node, node->count, shift);
+                node->count += shift;
+                ShiftLeft(next, shift, shift);
+                next->count -= shift;
+            }
+            return Normalize(node, index);
+        }
+
+        if (Node* previous = RealNode(node->previous)) {
+            if (previous->count + node->count <= Capacity) {
+                std::size_t base = previous->count;
+                Relocate(node, 0, previous, base, node->count);
+                previous->count += node->count;
+                node->count = 0;
+                FreeNode(node);
+                return Normalize(previous, base + index);
+            }
+            std::size_t shift = (previous->count - node->count) / 2;
+            ShiftRight(node, 0, shift);
+            Relocate(previous, previous->count - shift, node, 0, shift);
+            previous->count -= shift;
+            node->count += shift;
+            return Normalize(node, index + shift);
+        }
+
+        if (node->count == 0) {
+            FreeNode(node);
+            return end();
+        }
+        return Normalize(node, index);
+    }
+};
+
+#endif  // UNROLLEDLIST_H
@@ -0,0 +1,104 @@
+// g++ -std=c++20 -O2 -DNDEBUG -pthread -I. bench/atomic_shared_ptr_bench.cpp && ./a.out
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bench/bench.h"
+#include "shared_ptr.h"
+
+constexpr int kReads = 2000000;
+
+struct Config {
+    int limits[16] = {};
+};
+
+// A shared_ptr behind a mutex, the simplest way to publish a config.
+class LockedConfig {
+    mutable std::mutex mutex_;
+    std::shared_ptr<Config> config_ = std::make_shared<Config>();
+
+public:
+    std::shared_ptr<Config> load() const {
+        std::lock_guard lock(mutex_);
+        return config_;
+    }
+
+    void store(std::shared_ptr<Config> config) {
+        std::lock_guard lock(mutex_);
+        config_ = std::move(config);
+    }
+};
+
+// Each of readers threads reads kReads times while one writer republishes
+// every 100 microseconds. read() makes a thread's reader function.
+template <typename Read, typename Write>
+double Run(int readers, Read read, Write write) {
+    return BestOf(3, static_cast<long>(readers) * kReads, [&] {
+        std::atomic<bool> done = false;
+        std::thread writer([&] {
+            while (!done.load(std::memory_order_relaxed)) {
+                write();
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        });
+        std::vector<std::thread> workers;
+        for (int r = 0; r < readers; ++r) {
+            workers.emplace_back([&] {
+                long sum = 0;
+                auto reader = read();
+                for (int i = 0; i < kReads; ++i) {
+                    sum += reader()->limits[i & 15];
+                }
+                Keep(sum);
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        done = true;
+        writer.join();
+    });
+}
+
+int main() {
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    AtomicSharedPtr<Config> split(makeShared<Config>());
+    std::atomic<std::shared_ptr<Config>> standard(std::make_shared<Config>());
+    LockedConfig locked;
+    auto load_split = [&] {
+        return [&] { return split.load(); };
+    };
+    auto get_cached = [&] {
+        return [cached = CachedReader<Config>(split)]() mutable -> const SharedPtr<Config>& {
+            return cached.get();
+        };
+    };
+    auto load_standard = [&] {
+        return [&] { return standard.load(); };
+    };
+    auto load_locked = [&] {
+        return [&] { return locked.load(); };
+    };
+    auto store_split = [&] {
+        split.store(makeShared<Config>());
+    };
+    auto store_standard = [&] {
+        standard.store(std::make_shared<Config>());
+    };
+    auto store_locked = [&] {
+        locked.store(std::make_shared<Config>());
+    };
+    for (int readers : { 1, 4 }) {
+        std::printf("%d reader(s)\n", readers);
+        Report("  AtomicSharedPtr::load", Run(readers, load_split, store_split));
+        Report("  CachedReader::get", Run(readers, get_cached, store_split));
+        Report("  std::atomic<std::shared_ptr>::load", Run(readers, load_standard, store_standard));
+        Report("  mutex + std::shared_ptr", Run(readers, load_locked, store_locked));
+    }
+    return 0;
+}
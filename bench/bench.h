@@ -0,0 +1,48 @@
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+// Keeps the compiler from dropping a computation whose result is unused.
+template <typename T>
+void Keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Runs body reps times and returns the best time per operation in
+// nanoseconds; body performs ops operations per call.
+template <typename Body>
+double BestOf(int reps, long ops, Body body) {
+    double best = 1e300;
+    for (int rep = 0; rep < reps; ++rep) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / ops);
+    }
+    return best;
+}
+
+// Same, but times only body(state) where state = setup() is rebuilt before
+// every run.
+template <typename Setup, typename Body>
+double BestOf(int reps, long ops, Setup setup, Body body) {
+    double best = 1e300;
+    for (int rep = 0; rep < reps; ++rep) {
+        auto state = setup();
+        auto start = std::chrono::steady_clock::now();
+        body(state);
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / ops);
+        Keep(state);
+    }
+    return best;
+}
+
+inline void Report(const char* name, double ns_per_op) {
+    std::printf("%-48s %8.2f ns/op\n", name, ns_per_op);
+}
+
+#endif  // BENCH_BENCH_H
@@ -0,0 +1,80 @@
+// g++ -std=c++20 -O2 -DNDEBUG -pthread -I. bench/biased_ref_count_bench.cpp && ./a.out
+
+#include <cstdio>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "bench/bench.h"
+#include "shared_ptr.h"
+
+constexpr int kOps = 10000000;
+
+struct Object {
+    long value = 1;
+};
+
+// Copies and drops one reference per operation on the owning thread.
+template <typename Policy>
+double OwnerCopy() {
+    auto source = basicMakeShared<Object, Policy>();
+    return BestOf(5, kOps, [&] {
+        long sum = 0;
+        for (int i = 0; i < kOps; ++i) {
+            SharedPtr<Object, Policy> copy = source;
+            sum += copy->value;
+        }
+        Keep(sum);
+    });
+}
+
+// Locks a WeakPtr on the owning thread.
+template <typename Policy>
+double OwnerLock() {
+    auto source = basicMakeShared<Object, Policy>();
+    WeakPtr<Object, Policy> weak = source;
+    return BestOf(5, kOps, [&] {
+        for (int i = 0; i < kOps; ++i) {
+            auto locked = weak.lock();
+            Keep(locked);
+        }
+    });
+}
+
+// Creates objects and hands a copy of every sixteenth one to another
+// thread, which drops it there: mostly private objects with a few that
+// escape.
+template <typename Policy>
+double Escapes() {
+    constexpr int kObjects = 200000;
+    return BestOf(5, kObjects, [&] {
+        std::vector<SharedPtr<Object, Policy>> escaped;
+        std::vector<SharedPtr<Object, Policy>> objects;
+        objects.reserve(kObjects);
+        for (int i = 0; i < kObjects; ++i) {
+            objects.push_back(basicMakeShared<Object, Policy>());
+            for (int copy = 0; copy < 8; ++copy) {
+                SharedPtr<Object, Policy> local = objects.back();
+                Keep(local);
+            }
+            if (i % 16 == 0) {
+                escaped.push_back(objects.back());
+            }
+        }
+        std::thread([&escaped] { escaped.clear(); }).join();
+        objects.clear();
+        if constexpr (std::is_same_v<Policy, BiasedRefCount>) {
+            BiasedRefCount::MergePending();
+        }
+    });
+}
+
+int main() {
+    Report("owner copy, AtomicRefCount", OwnerCopy<AtomicRefCount>());
+    Report("owner copy, BiasedRefCount", OwnerCopy<BiasedRefCount>());
+    Report("owner lock, AtomicRefCount", OwnerLock<AtomicRefCount>());
+    Report("owner lock, BiasedRefCount", OwnerLock<BiasedRefCount>());
+    Report("1 in 16 escapes, AtomicRefCount", Escapes<AtomicRefCount>());
+    Report("1 in 16 escapes, BiasedRefCount", Escapes<BiasedRefCount>());
+    return 0;
+}
@@ -0,0 +1,65 @@
+// g++ -std=c++20 -O2 -DNDEBUG -pthread -I. bench/concurrent_stack_storage_bench.cpp && ./a.out
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "StackAllocator.h"
+#include "bench/bench.h"
+
+constexpr std::size_t kArena = std::size_t(1) << 27;
+constexpr int kAllocations = 200000;
+
+// A plain StackStorage behind a mutex, the alternative to lock-free bumping.
+class LockedStackStorage {
+    StackStorage<kArena> storage_;
+    std::mutex mutex_;
+
+public:
+    void* allocate_raw(std::size_t st_mem, std::size_t sz) {
+        std::lock_guard lock(mutex_);
+        return storage_.allocate_raw(st_mem, sz);
+    }
+
+    void reset() noexcept {
+        storage_.reset();
+    }
+};
+
+// Every thread makes kAllocations small requests of mixed sizes; reports
+// the time per allocation across all threads.
+template <typename Storage>
+double Run(Storage& storage, int threads) {
+    return BestOf(5, static_cast<long>(threads) * kAllocations, [&] {
+        storage.reset();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&storage] {
+                for (int i = 0; i < kAllocations; ++i) {
+                    void* ptr = storage.allocate_raw(8, 8 + (i % 4) * 8);
+                    Keep(ptr);
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    });
+}
+
+int main() {
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    auto locked = std::make_unique<LockedStackStorage>();
+    auto shared = std::make_unique<ConcurrentStackStorage<kArena>>(0);
+    auto chunked = std::make_unique<ConcurrentStackStorage<kArena>>(4096);
+    for (int threads : { 1, 2, 4, 8 }) {
+        std::string suffix = ", " + std::to_string(threads) + " threads";
+        Report(("mutex + StackStorage" + suffix).c_str(), Run(*locked, threads));
+        Report(("ConcurrentStackStorage, no chunks" + suffix).c_str(), Run(*shared, threads));
+        Report(("ConcurrentStackStorage, 4 KiB chunks" + suffix).c_str(), Run(*chunked, threads));
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+// g++ -std=c++20 -O2 -DNDEBUG -pthread -I. bench/control_block_pool_bench.cpp && ./a.out
+
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "bench/bench.h"
+#include "shared_ptr.h"
+
+constexpr int kObjects = 200000;
+
+// Objects are allocated outside the timed part; deleting them costs every
+// variant the same.
+std::vector<long*> Objects() {
+    std::vector<long*> objects(kObjects);
+    for (long*& object : objects) {
+        object = new long(1);
+    }
+    return objects;
+}
+
+// Adopts every object and drops the pointers, on the calling thread or,
+// with remote, on another one.
+template <typename Adopt>
+double Run(Adopt adopt, bool remote) {
+    return BestOf(5, kObjects, Objects, [&](std::vector<long*>& objects) {
+        using Ptr = decltype(adopt(nullptr));
+        std::vector<Ptr> pointers;
+        pointers.reserve(kObjects);
+        for (long* object : objects) {
+            pointers.push_back(adopt(object));
+        }
+        if (remote) {
+            std::thread([&pointers] { pointers.clear(); }).join();
+        }
+        else {
+            pointers.clear();
+        }
+    });
+}
+
+int main() {
+    // libstdc++'s shared_ptr skips atomics until the process starts a
+    // thread; start one so that it pays what it would in real use.
+    std::thread([] {
+    }).join();
+    auto pooled = [](long* object) {
+        return SharedPtr<long>(object);
+    };
+    auto heap = [](long* object) {
+        return SharedPtr<long>(object, std::default_delete<long>(), std::allocator<long>());
+    };
+    auto standard = [](long* object) {
+        return std::shared_ptr<long>(object);
+    };
+    for (bool remote : { false, true }) {
+        std::printf(remote ? "released on another thread\n" : "released on the same thread\n");
+        Report("  SharedPtr(ptr), pooled block", Run(pooled, remote));
+        Report("  SharedPtr(ptr, deleter, std::allocator)", Run(heap, remote));
+        Report("  std::shared_ptr(ptr)", Run(standard, remote));
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+// g++ -std=c++20 -O2 -DNDEBUG -pthread -I. bench/intrusive_ptr_bench.cpp && ./a.out
+
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "bench/bench.h"
+#include "intrusive_ptr.h"
+#include "shared_ptr.h"
+
+constexpr int kObjects = 1000000;
+
+struct Node : IntrusiveRefCounted<Node> {
+    long value = 1;
+};
+
+struct PlainNode {
+    long value = 1;
+};
+
+template <typename Make>
+auto MakeAll(Make make) {
+    std::vector<decltype(make())> pointers;
+    pointers.reserve(kObjects);
+    for (int i = 0; i < kObjects; ++i) {
+        pointers.push_back(make());
+    }
+    return pointers;
+}
+
+// Each operation is timed on its own over kObjects pointers; building the
+// pointers it works on is not timed.
+template <typename Make>
+void Run(const char* name, Make make) {
+    using Ptr = decltype(make());
+    struct Copies {
+        std::vector<Ptr> pointers;
+        std::vector<Ptr> copies;
+    };
+    auto with_copies = [&] {
+        Copies state { MakeAll(make), std::vector<Ptr>(kObjects) };
+        for (int i = 0; i < kObjects; ++i) {
+            state.copies[i] = state.pointers[i];
+        }
+        return state;
+    };
+    double create = BestOf(5, kObjects, [] {
+        return std::vector<Ptr>(kObjects);
+    }, [&](std::vector<Ptr>& pointers) {
+        for (Ptr& ptr : pointers) {
+            ptr = make();
+        }
+    });
+    double copy = BestOf(5, kObjects, [&] {
+        return Copies { MakeAll(make), std::vector<Ptr>(kObjects) };
+    }, [](Copies& state) {
+        for (int i = 0; i < kObjects; ++i) {
+            state.copies[i] = state.pointers[i];
+        }
+    });
+    double release = BestOf(5, kObjects, with_copies, [](Copies& state) {
+        state.copies.clear();
+    });
+    double destroy = BestOf(5, kObjects, [&] {
+        return MakeAll(make);
+    }, [](std::vector<Ptr>& pointers) {
+        pointers.clear();
+    });
+    double dereference = BestOf(5, kObjects, [&] {
+        return MakeAll(make);
+    }, [](std::vector<Ptr>& pointers) {
+        long sum = 0;
+        for (const Ptr& ptr : pointers) {
+            sum += ptr->value;
+        }
+        Keep(sum);
+    });
+    std::printf("%-18s create %6.2f  copy %6.2f  release %6.2f  destroy %6.2f  deref %5.2f ns\n", name, create,
+                copy, release, destroy, dereference);
+}
+
+int main() {
+    // libstdc++'s shared_ptr skips atomics until the process starts a
+    // thread; start one so that it pays what it would in real use.
+    std::thread([] {
+    }).join();
+    std::printf("release drops a copy, destroy drops the last reference and frees the object\n");
+    Run("makeIntrusive", [] { return makeIntrusive<Node>(); });
+    Run("makeShared", [] { return makeShared<PlainNode>(); });
+    Run("SharedPtr(new T)", [] { return SharedPtr<PlainNode>(new PlainNode()); });
+    Run("std::make_shared", [] { return std::make_shared<PlainNode>(); });
+    std::printf("pointer sizes: IntrusivePtr %zu, SharedPtr %zu, std::shared_ptr %zu bytes\n",
+                sizeof(IntrusivePtr<Node>), sizeof(SharedPtr<PlainNode>), sizeof(std::shared_ptr<PlainNode>));
+    return 0;
+}
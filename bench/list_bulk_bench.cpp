@@ -0,0 +1,95 @@
+// g++ -std=c++20 -O2 -DNDEBUG -I. bench/list_bulk_bench.cpp && ./a.out
+
+#include <list>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+#include "PoolAllocator.h"
+#include "StackAllocator.h"
+#include "bench/bench.h"
+
+constexpr int kLength = 1000000;
+constexpr std::size_t kArena = std::size_t(1) << 26;
+
+using Arena = StackAllocator<int, kArena>;
+
+// Only arena-backed lists take nodes in runs; heap lists are built node by
+// node whichever way they are filled, so they are timed once, with push_back.
+enum class Fill {
+    kPushBack,
+    kRangeInsert,
+    kCountValue,
+};
+
+template <typename Make>
+auto Build(Fill fill, const std::vector<int>& values, Make make) {
+    if (fill == Fill::kCountValue) {
+        return make(kLength);
+    }
+    auto list = make(0);
+    if (fill == Fill::kRangeInsert) {
+        list.insert(list.end(), values.begin(), values.end());
+    }
+    else {
+        for (int value : values) {
+            list.push_back(value);
+        }
+    }
+    return list;
+}
+
+// Times building a kLength list, then separately summing a freshly built
+// one; teardown is not timed. make(n) returns a list of n elements and
+// prepare() runs, untimed, before every build.
+template <typename Make, typename Prepare>
+void Run(const char* name, Fill fill, Make make, Prepare prepare) {
+    std::vector<int> values(kLength);
+    std::iota(values.begin(), values.end(), 0);
+    double build = BestOf(5, kLength, [&] {
+        prepare();
+        return std::optional<decltype(Build(fill, values, make))>();
+    }, [&](auto& slot) {
+        slot.emplace(Build(fill, values, make));
+    });
+    double iterate = BestOf(5, kLength, [&] {
+        prepare();
+        return Build(fill, values, make);
+    }, [](auto& list) {
+        long sum = 0;
+        for (int value : list) {
+            sum += value;
+        }
+        Keep(sum);
+    });
+    std::printf("%-44s build %6.2f  iterate %6.2f ns/node\n", name, build, iterate);
+}
+
+int main() {
+    auto storage = std::make_unique<StackStorage<kArena>>();
+    auto rewind = [&] {
+        storage->reset();
+    };
+    auto nothing = [] {
+    };
+    auto make_std = [](std::size_t n) {
+        return std::list<int>(n);
+    };
+    auto make_heap = [](std::size_t n) {
+        return List<int>(n);
+    };
+    auto make_pool = [](std::size_t n) {
+        return List<int, PoolAllocator<int>>(n);
+    };
+    auto make_arena = [&](std::size_t n) {
+        return List<int, Arena>(n, Arena(*storage));
+    };
+    Run("std::list push_back", Fill::kPushBack, make_std, nothing);
+    Run("List<int> push_back", Fill::kPushBack, make_heap, nothing);
+    Run("List<int, PoolAllocator> push_back", Fill::kPushBack, make_pool, nothing);
+    Run("List<int, StackAllocator> push_back", Fill::kPushBack, make_arena, rewind);
+    Run("List<int, StackAllocator> range insert", Fill::kRangeInsert, make_arena, rewind);
+    Run("List<int, StackAllocator> List(n)", Fill::kCountValue, make_arena, rewind);
+    return 0;
+}
@@ -0,0 +1,62 @@
+// g++ -std=c++20 -O2 -DNDEBUG -I. bench/list_sort_bench.cpp && ./a.out
+
+#include <algorithm>
+#include <list>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "StackAllocator.h"
+#include "bench/bench.h"
+
+constexpr int kElements = 1000000;
+
+std::vector<int> RandomValues() {
+    std::mt19937 rng(1);
+    std::vector<int> values(kElements);
+    for (int& value : values) {
+        value = static_cast<int>(rng() % 1000);
+    }
+    return values;
+}
+
+// Copies into a vector, sorts it and rebuilds the list from it, freeing the
+// old nodes: the usual workaround when a list has no cheap sort.
+template <typename L>
+void SortThroughVector(L& list) {
+    std::vector<int> values(list.begin(), list.end());
+    std::stable_sort(values.begin(), values.end());
+    L sorted;
+    sorted.insert(sorted.end(), values.begin(), values.end());
+    list = std::move(sorted);
+}
+
+template <typename L, typename Operation>
+double Measure(Operation operation) {
+    std::vector<int> values = RandomValues();
+    auto fill = [&values] {
+        L list;
+        for (int value : values) {
+            list.push_back(value);
+        }
+        return list;
+    };
+    return BestOf(5, kElements, fill, operation);
+}
+
+int main() {
+    Report("std::list sort", Measure<std::list<int>>([](auto& list) { list.sort(); }));
+    Report("List sort", Measure<List<int>>([](auto& list) { list.sort(); }));
+    Report("List sort through a vector", Measure<List<int>>([](auto& list) { SortThroughVector(list); }));
+    Report("std::list sort + unique", Measure<std::list<int>>([](auto& list) {
+        list.sort();
+        list.unique();
+    }));
+    Report("List sort + unique", Measure<List<int>>([](auto& list) {
+        list.sort();
+        list.unique();
+    }));
+    Report("std::list reverse", Measure<std::list<int>>([](auto& list) { list.reverse(); }));
+    Report("List reverse", Measure<List<int>>([](auto& list) { list.reverse(); }));
+    return 0;
+}
@@ -0,0 +1,85 @@
+// g++ -std=c++20 -O2 -DNDEBUG -I. bench/lru_cache_bench.cpp && ./a.out
+
+#include <list>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "LruCache.h"
+#include "PoolAllocator.h"
+#include "bench/bench.h"
+
+constexpr std::size_t kCapacity = 10000;
+constexpr int kOps = 1000000;
+
+// The textbook LRU: a std::list in recency order and an unordered_map from
+// keys to list iterators.
+class ListMapLru {
+    std::size_t capacity_;
+    std::list<std::pair<int, long>> entries_;
+    std::unordered_map<int, std::list<std::pair<int, long>>::iterator> index_;
+
+public:
+    explicit ListMapLru(std::size_t capacity) : capacity_(capacity) {
+        index_.reserve(2 * capacity);
+    }
+
+    long* find(int key) {
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            return nullptr;
+        }
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return &it->second->second;
+    }
+
+    void put(int key, long value) {
+        if (long* found = find(key)) {
+            *found = value;
+            return;
+        }
+        if (entries_.size() == capacity_) {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+        entries_.emplace_front(key, value);
+        index_.emplace(key, entries_.begin());
+    }
+};
+
+// Keys follow a geometric distribution with mean span; a miss is
+// followed by a put, as a read-through cache would do.
+template <typename Cache>
+double Run(Cache cache, std::size_t span) {
+    std::mt19937 rng(1);
+    std::vector<int> keys(kOps);
+    std::geometric_distribution<int> skew(1.0 / static_cast<double>(span));
+    for (int& key : keys) {
+        key = skew(rng);
+    }
+    long hits = 0;
+    double ns = BestOf(3, kOps, [&] {
+        for (int key : keys) {
+            if (long* found = cache.find(key)) {
+                hits += *found;
+            }
+            else {
+                cache.put(key, key);
+            }
+        }
+    });
+    Keep(hits);
+    return ns;
+}
+
+int main() {
+    for (std::size_t span : { kCapacity / 2, kCapacity, 4 * kCapacity }) {
+        std::printf("mean key %zu, capacity %zu\n", span, kCapacity);
+        Report("  std::list + std::unordered_map", Run(ListMapLru(kCapacity), span));
+        Report("  LruCache", Run(LruCache<int, long>(kCapacity), span));
+        Report("  LruCache over PoolAllocator",
+               Run(LruCache<int, long, PoolAllocator<std::pair<int, long>>>(kCapacity), span));
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+// g++ -std=c++20 -O2 -DNDEBUG -I. bench/pool_allocator_bench.cpp && ./a.out
+
+#include <list>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "PoolAllocator.h"
+#include "StackAllocator.h"
+#include "bench/bench.h"
+
+constexpr int kElements = 100000;
+constexpr std::size_t kArenaSize = std::size_t(1) << 26;
+
+using Arena = StackStorage<kArenaSize>;
+using ArenaList = List<int, StackAllocator<int, kArenaSize>>;
+
+// Fills a list from make(), then erases and re-inserts at random positions,
+// so freed nodes are reused in a scattered order.
+template <typename Make>
+double Churn(Make make) {
+    return BestOf(5, 2 * kElements, [&] {
+        auto list = make();
+        std::vector<decltype(list.begin())> positions;
+        for (int i = 0; i < kElements; ++i) {
+            list.push_back(i);
+            positions.push_back(std::prev(list.end()));
+        }
+        std::mt19937 rng(1);
+        for (int i = 0; i < kElements; ++i) {
+            std::size_t at = rng() % positions.size();
+            auto next = list.erase(positions[at]);
+            positions[at] = list.insert(next, i);
+        }
+        Keep(list);
+    });
+}
+
+// Builds and tears down a short list over and over.
+template <typename Make>
+double Cycles(Make make) {
+    constexpr int kLength = 64;
+    constexpr int kRounds = 20000;
+    return BestOf(5, static_cast<long>(kLength) * kRounds, [&] {
+        for (int round = 0; round < kRounds; ++round) {
+            auto list = make();
+            for (int i = 0; i < kLength; ++i) {
+                list.push_back(i);
+            }
+            Keep(list);
+        }
+    });
+}
+
+int main() {
+    auto arena = std::make_unique<Arena>();
+    // The arena never reuses freed nodes, so it is rewound once per run;
+    // build/teardown rewinds it every round, like a scratch arena would be.
+    auto fresh_arena = [&arena] {
+        arena->reset();
+        return ArenaList(StackAllocator<int, kArenaSize>(*arena));
+    };
+    Report("churn std::list", Churn([] { return std::list<int>(); }));
+    Report("churn List<int, std::allocator>", Churn([] { return List<int>(); }));
+    Report("churn List<int, PoolAllocator>", Churn([] { return List<int, PoolAllocator<int>>(); }));
+    Report("churn List<int, StackAllocator>", Churn(fresh_arena));
+    Report("build/teardown std::list", Cycles([] { return std::list<int>(); }));
+    Report("build/teardown List<int, std::allocator>", Cycles([] { return List<int>(); }));
+    Report("build/teardown List<int, PoolAllocator>", Cycles([] { return List<int, PoolAllocator<int>>(); }));
+    Report("build/teardown List<int, StackAllocator>", Cycles(fresh_arena));
+    return 0;
+}
@@ -0,0 +1,72 @@
+// g++ -std=c++20 -O2 -DNDEBUG -pthread -I. bench/ref_count_bench.cpp && ./a.out
+
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "bench/bench.h"
+#include "shared_ptr.h"
+
+constexpr int kOps = 10000000;
+
+// Copy-construct and destroy one reference per operation.
+template <typename Ptr>
+double Copy(const Ptr& source) {
+    return BestOf(5, kOps, [&] {
+        for (int i = 0; i < kOps; ++i) {
+            Ptr copy = source;
+            Keep(copy);
+        }
+    });
+}
+
+template <typename Weak>
+double Lock(const Weak& weak) {
+    return BestOf(5, kOps, [&] {
+        for (int i = 0; i < kOps; ++i) {
+            auto locked = weak.lock();
+            Keep(locked);
+        }
+    });
+}
+
+// Several threads copy the same pointer at once.
+template <typename Ptr>
+double Shared(const Ptr& source, int threads) {
+    const int per_thread = kOps / threads;
+    return BestOf(3, static_cast<long>(per_thread) * threads, [&] {
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&source, per_thread] {
+                for (int i = 0; i < per_thread; ++i) {
+                    Ptr copy = source;
+                    Keep(copy);
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    });
+}
+
+int main() {
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    // libstdc++'s shared_ptr skips atomics until the process starts a
+    // thread; start one so that it pays what it would in real use.
+    std::thread([] {
+    }).join();
+    auto single = basicMakeShared<int, SingleThreadRefCount>(1);
+    auto atomic = makeShared<int>(1);
+    auto standard = std::make_shared<int>(1);
+    Report("copy SharedPtr<int, SingleThreadRefCount>", Copy(single));
+    Report("copy SharedPtr<int> (AtomicRefCount)", Copy(atomic));
+    Report("copy std::shared_ptr<int>", Copy(standard));
+    Report("lock WeakPtr<int, SingleThreadRefCount>", Lock(WeakPtr<int, SingleThreadRefCount>(single)));
+    Report("lock WeakPtr<int> (AtomicRefCount)", Lock(WeakPtr<int>(atomic)));
+    Report("lock std::weak_ptr<int>", Lock(std::weak_ptr<int>(standard)));
+    Report("copy SharedPtr<int>, 4 threads", Shared(atomic, 4));
+    Report("copy std::shared_ptr<int>, 4 threads", Shared(standard, 4));
+    return 0;
+}
@@ -0,0 +1,162 @@
+#ifndef INTRUSIVEPTR_H
+#define INTRUSIVEPTR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "shared_ptr.h"
+
+// Embedded reference count for IntrusivePtr. Unlike a control block it starts
+// at zero: the first IntrusivePtr to adopt the object takes the first
+// reference, so an IntrusivePtr can be rebuilt from `this` at any time.
+template <typename T, typename Policy = AtomicRefCount>
+class IntrusiveRefCounted {
+ public:
+  size_t use_count() const noexcept {
+    if constexpr (kAtomic) {
+      return ref_count_.load(std::memory_order_relaxed);
+    } else {
+      return ref_count_;
+    }
+  }
+
+ protected:
+  IntrusiveRefCounted() noexcept = default;
+
+  // A copy is a new object with its own owners.
+  IntrusiveRefCounted(const IntrusiveRefCounted&) noexcept {
+  }
+
+  IntrusiveRefCounted& operator=(const IntrusiveRefCounted&) noexcept {
+    return *this;
+  }
+
+  ~IntrusiveRefCounted() = default;
+
+ private:
+  static constexpr bool kAtomic = !std::is_same_v<Policy, SingleThreadRefCount>;
+
+  mutable std::conditional_t<kAtomic, std::atomic<std::uint32_t>, std::uint32_t> ref_count_ = 0;
+
+  friend void IntrusiveAddRef(const IntrusiveRefCounted* ptr) noexcept {
+    if constexpr (kAtomic) {
+      ptr->ref_count_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      ++ptr->ref_count_;
+    }
+  }
+
+  friend void IntrusiveRelease(const IntrusiveRefCounted* ptr) noexcept {
+    bool last;
+    if constexpr (kAtomic) {
+      last = ptr->ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    } else {
+      last = --ptr->ref_count_ == 0;
+    }
+    if (last) {
+      delete static_cast<const T*>(ptr);
+    }
+  }
+};
+
+// Pointer to an object that counts its own references. T provides the hooks
+// IntrusiveAddRef(const T*) and IntrusiveRelease(const T*), found by ADL;
+// IntrusiveRefCounted supplies both.
+template <typename T>
+class IntrusivePtr {
+ public:
+  using element_type = T;
+
+  IntrusivePtr() noexcept : ptr_(nullptr) {
+  }
+
+  // add_ref = false adopts a reference that was taken or detached earlier.
+  IntrusivePtr(T* ptr, bool add_ref = true) noexcept : ptr_(ptr) {
+    if (ptr_ != nullptr && add_ref) {
+      IntrusiveAddRef(ptr_);
+    }
+  }
+
+  IntrusivePtr(const IntrusivePtr& other) noexcept : IntrusivePtr(other.ptr_) {
+  }
+
+  IntrusivePtr(IntrusivePtr&& other) noexcept : ptr_(std::exchange(other.ptr_, nullptr)) {
+  }
+
+  template <typename U>
+    requires std::is_convertible_v<U*, T*>
+  IntrusivePtr(const IntrusivePtr<U>& other) noexcept : IntrusivePtr(other.get()) {
+  }
+
+  template <typename U>
+    requires std::is_convertible_v<U*, T*>
+  IntrusivePtr(IntrusivePtr<U>&& other) noexcept : ptr_(other.detach()) {
+  }
+
+  IntrusivePtr& operator=(const IntrusivePtr& other) noexcept {
+    IntrusivePtr(other).swap(*this);
+    return *this;
+  }
+
+  IntrusivePtr& operator=(IntrusivePtr&& other) noexcept {
+    IntrusivePtr(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  ~IntrusivePtr() {
+    if (ptr_ != nullptr) {
+      IntrusiveRelease(ptr_);
+    }
+  }
+
+  void reset() noexcept {
+    IntrusivePtr().swap(*this);
+  }
+
+  void reset(T* ptr, bool add_ref = true) noexcept {
+    IntrusivePtr(ptr, add_ref).swap(*this);
+  }
+
+  // Gives up ownership without dropping the reference.
+  T* detach() noexcept {
+    return std::exchange(ptr_, nullptr);
+  }
+
+  T* get() const noexcept {
+    return ptr_;
+  }
+
+  T& operator*() const noexcept {
+    return *ptr_;
+  }
+
+  T* operator->() const noexcept {
+    return ptr_;
+  }
+
+  explicit operator bool() const noexcept {
+    return ptr_ != nullptr;
+  }
+
+  void swap(IntrusivePtr& other) noexcept {
+    std::swap(ptr_, other.ptr_);
+  }
+
+  template <typename U>
+  bool operator==(const IntrusivePtr<U>& other) const noexcept {
+    return ptr_ == other.get();
+  }
+
+ private:
+  T* ptr_;
+};
+
+template <typename T, typename... Args>
+IntrusivePtr<T> makeIntrusive(Args&&... args) {
+  return IntrusivePtr<T>(new T(std::forward<Args>(args)...));
+}
+
+#endif  // INTRUSIVEPTR_H
@@ -0,0 +1,181 @@
+#ifndef RECLAMATIONQUEUE_H
+#define RECLAMATIONQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "shared_ptr.h"
+
+// Objects retired here are deleted later, in batches, by drain() or by the
+// background thread started with start(), instead of inline on the thread
+// that dropped the last reference. The queue is a fixed ring: when it is
+// full, the retiring thread deletes one batch itself before queueing, which
+// bounds both memory and the work any single release can be charged with.
+class ReclamationQueue {
+ public:
+  static constexpr size_t kBatch = 64;
+
+  explicit ReclamationQueue(size_t capacity = 4096) : ring_(capacity) {
+    if (capacity == 0) {
+      throw std::invalid_argument("ReclamationQueue needs a non-zero capacity");
+    }
+  }
+
+  ReclamationQueue(const ReclamationQueue&) = delete;
+
+  ReclamationQueue& operator=(const ReclamationQueue&) = delete;
+
+  // Stops the background thread and deletes whatever is still queued.
+  ~ReclamationQueue() {
+    stop();
+    drain();
+  }
+
+  // The object is later released with deleter(ptr), by default with delete.
+  // The deleter is kept in the queue slot, so it must be trivially copyable
+  // and no larger than two pointers: a function pointer, or a lambda that
+  // captures the pool the object came from.
+  template <typename T, typename Deleter = std::default_delete<T>>
+  void retire(T* ptr, Deleter deleter = Deleter()) {
+    static_assert(std::is_trivially_copyable_v<Deleter> && sizeof(Deleter) <= sizeof(Retired::deleter) &&
+                      alignof(Deleter) <= alignof(Retired),
+                  "ReclamationQueue stores the deleter inline");
+    if (ptr == nullptr) {
+      return;
+    }
+    Retired retired;
+    retired.object = ptr;
+    retired.destroy = [](void* object, void* stored) {
+      (*std::launder(static_cast<Deleter*>(stored)))(static_cast<T*>(object));
+    };
+    ::new (static_cast<void*>(retired.deleter)) Deleter(deleter);
+    Push(retired);
+  }
+
+  // Deletes everything queued so far; returns how many objects were deleted.
+  size_t drain() {
+    size_t total = 0;
+    while (size_t deleted = DrainBatch()) {
+      total += deleted;
+    }
+    return total;
+  }
+
+  void start() {
+    std::lock_guard lock(mutex_);
+    if (worker_.joinable()) {
+      return;
+    }
+    stopping_ = false;
+    worker_ = std::thread([this] { Run(); });
+  }
+
+  // Joins the background thread; objects still queued wait for drain().
+  void stop() {
+    {
+      std::lock_guard lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    if (worker_.joinable()) {
+      worker_.join();
+    }
+  }
+
+  size_t pending() const {
+    std::lock_guard lock(mutex_);
+    return size_;
+  }
+
+  size_t capacity() const noexcept {
+    return ring_.size();
+  }
+
+ private:
+  struct Retired {
+    void* object;
+    void (*destroy)(void* object, void* deleter);
+    alignas(void*) unsigned char deleter[2 * sizeof(void*)];
+  };
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::vector<Retired> ring_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+  bool stopping_ = false;
+  std::thread worker_;
+
+  void Push(Retired retired) {
+    std::unique_lock lock(mutex_);
+    while (size_ == ring_.size()) {
+      lock.unlock();
+      DrainBatch();
+      lock.lock();
+    }
+    ring_[(head_ + size_) % ring_.size()] = retired;
+    if (size_++ == 0) {
+      wake_.notify_one();
+    }
+  }
+
+  // Destructors run outside the lock so that they may retire more objects.
+  size_t DrainBatch() {
+    Retired batch[kBatch];
+    size_t count = 0;
+    {
+      std::lock_guard lock(mutex_);
+      while (count < kBatch && size_ > 0) {
+        batch[count++] = ring_[head_];
+        head_ = (head_ + 1) % ring_.size();
+        --size_;
+      }
+    }
+    for (size_t i = 0; i < count; ++i) {
+      batch[i].destroy(batch[i].object, batch[i].deleter);
+    }
+    return count;
+  }
+
+  void Run() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+      wake_.wait(lock, [this] { return stopping_ || size_ > 0; });
+      if (stopping_) {
+        return;
+      }
+      lock.unlock();
+      drain();
+      lock.lock();
+    }
+  }
+};
+
+// Deleter that hands the object to a ReclamationQueue, which later releases
+// it with deleter. The object counts as destroyed for its owners as soon as
+// the last reference goes: WeakPtrs expire and lock() fails from that point
+// on.
+template <typename T, typename Deleter = std::default_delete<T>>
+struct DeferredDelete {
+  ReclamationQueue* queue;
+  [[no_unique_address]] Deleter deleter = Deleter();
+
+  void operator()(T* ptr) const {
+    queue->retire(ptr, deleter);
+  }
+};
+
+template <typename T, typename Policy = AtomicRefCount, typename... Args>
+SharedPtr<T, Policy> makeDeferredShared(ReclamationQueue& queue, Args&&... args) {
+  return SharedPtr<T, Policy>(new T(std::forward<Args>(args)...), DeferredDelete<T>{&queue});
+}
+
+#endif  // RECLAMATIONQUEUE_H
@@ -0,0 +1,151 @@
+#ifndef SHAREDARENA_H
+#define SHAREDARENA_H
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "StackAllocator.h"
+#include "shared_ptr.h"
+
+// Stray-reference checks in reset() run in debug builds only.
+#ifdef NDEBUG
+inline constexpr bool kSharedArenaChecks = false;
+#else
+inline constexpr bool kSharedArenaChecks = true;
+#endif
+
+// Places SharedPtr objects and their control blocks in one arena and tears
+// the whole graph down at once. Pointers from make() keep counts, but dropping
+// them never destroys anything. reset() runs the destructors of the objects
+// that have one, in creation order, and then rewinds the arena. A graph of
+// trivially destructible objects is released in O(1).
+// Like the arena itself, a SharedArena is meant for one thread.
+template <typename Storage>
+class SharedArena {
+  // Counts as SingleThreadRefCount does, so use_count() and WeakPtr::lock()
+  // behave as usual, but reaching zero never destroys or frees anything:
+  // reset() does both for the whole arena. Private because a SharedPtr with
+  // these counts made anywhere but make() would never be released.
+  class RefCount : public SingleThreadRefCount {
+   public:
+    bool ReleaseShared() noexcept {
+      SingleThreadRefCount::ReleaseShared();
+      return false;
+    }
+
+    bool ReleaseWeak() noexcept {
+      SingleThreadRefCount::ReleaseWeak();
+      return false;
+    }
+  };
+
+ public:
+  template <typename T>
+  using Pointer = SharedPtr<T, RefCount>;
+
+  template <typename T>
+  using WeakPointer = WeakPtr<T, RefCount>;
+
+  template <typename... Args>
+  explicit SharedArena(Args&&... args) : storage_(std::forward<Args>(args)...) {
+  }
+
+  SharedArena(const SharedArena&) = delete;
+
+  SharedArena& operator=(const SharedArena&) = delete;
+
+  // A stray reference found here in a debug build aborts the program.
+  ~SharedArena() {
+    reset();
+  }
+
+  // Same arguments as basicMakeShared. Throws std::bad_alloc when the arena
+  // is full. reset() destroys objects in the order make() was called for
+  // them, so a destructor may still use objects made after its own, such as
+  // children its constructor made, but not ones made before it.
+  template <typename T, typename... Args>
+  Pointer<T> make(Args&&... args) {
+    constexpr bool kFinalize = !std::is_trivially_destructible_v<std::remove_extent_t<T>>;
+    Tracked* tracked = nullptr;
+    Tracked** link = tail_;
+    if constexpr (kFinalize || kSharedArenaChecks || kSharedPtrInstrumentation) {
+      // Taken and linked first, so that a full arena cannot leave an object
+      // untracked and objects made by T's constructor come after it.
+      tracked = new (TrackedAllocator(storage_).allocate(1)) Tracked{nullptr, nullptr, kFinalize};
+      *tail_ = tracked;
+      tail_ = &tracked->next;
+    }
+    try {
+      Pointer<T> ptr = basicAllocateShared<T, RefCount>(Allocator<std::remove_extent_t<T>>(storage_),
+                                                         std::forward<Args>(args)...);
+      if (tracked != nullptr) {
+        tracked->block = ptr.block_;
+      }
+      return ptr;
+    } catch (...) {
+      if (tracked != nullptr) {
+        *link = tracked->next;
+        if (tail_ == &tracked->next) {
+          tail_ = link;
+        }
+      }
+      throw;
+    }
+  }
+
+  // Objects still referenced from outside the arena are destroyed all the
+  // same. In debug builds that is reported on stderr and aborts the program.
+  void reset() {
+    for (Tracked* tracked = tracked_; tracked != nullptr; tracked = tracked->next) {
+      tracked->block->probe.OnDestroyObject();
+      if (tracked->finalize) {
+        tracked->block->SharedDestroy();
+      }
+    }
+    // Destructors above drop the references objects hold on each other, so
+    // whatever is left comes from outside.
+    bool stray = false;
+    for (Tracked* tracked = tracked_; tracked != nullptr; tracked = tracked->next) {
+      if constexpr (kSharedArenaChecks) {
+        stray |= tracked->block->SharedCount() != 0 || !tracked->block->WeakUnique();
+      }
+      tracked->block->probe.OnDeallocate();
+    }
+    if (stray) {
+      std::fputs("SharedArena reset while a SharedPtr or WeakPtr into it is alive\n", stderr);
+      std::abort();
+    }
+    tracked_ = nullptr;
+    tail_ = &tracked_;
+    storage_.reset();
+  }
+
+  Storage& storage() noexcept {
+    return storage_;
+  }
+
+ private:
+  using Block = IBaseControlBlock<RefCount>;
+
+  template <typename T>
+  using Allocator = StackAllocator<T, 0, Storage>;
+
+  struct Tracked {
+    Tracked* next;
+    Block* block;
+    bool finalize;
+  };
+
+  using TrackedAllocator = Allocator<Tracked>;
+
+  Storage storage_;
+  // Oldest first; tail_ points at the last next link.
+  Tracked* tracked_ = nullptr;
+  Tracked** tail_ = &tracked_;
+};
+
+#endif  // SHAREDARENA_H
@@ -1,79 +1,986 @@
 #ifndef SHAREDPTR_H
 #define SHAREDPTR_H
  
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+ 
+#ifdef __GNUG__
+#include <cstdlib>
+#include <cxxabi.h>
+#endif
+ 
+// Reference-count policies. Both counts start at one: the weak count also
+// carries a single reference held collectively by the shared owners, which
+// is dropped after the object is destroyed. Counts are 32 bits wide so that
+// both fit in one 64-bit word.
+class SingleThreadRefCount {
+ public:
+  void AddShared() noexcept {
+    ++shared_count_;
+  }
+ 
+  // Returns true when the last shared owner is gone.
+  bool ReleaseShared() noexcept {
+    return --shared_count_ == 0;
+  }
+ 
+  // Adds a shared owner unless the object is already destroyed.
+  bool TryAddShared() noexcept {
+    if (shared_count_ == 0) {
+      return false;
+    }
+    ++shared_count_;
+    return true;
+  }
+ 
+  void AddWeak() noexcept {
+    ++weak_count_;
+  }
+ 
+  // Returns true when the control block can be freed.
+  bool ReleaseWeak() noexcept {
+    return --weak_count_ == 0;
+  }
+ 
+  // True when no WeakPtr is left besides the shared owners' reference.
+  bool WeakUnique() const noexcept {
+    return weak_count_ == 1;
+  }
+ 
+  size_t SharedCount() const noexcept {
+    return shared_count_;
+  }
+ 
+ private:
+  std::uint32_t shared_count_ = 1;
+  std::uint32_t weak_count_ = 1;
+};
+ 
+// Shared count in the low half of one atomic word, weak count in the high.
+class AtomicRefCount {
+ public:
+  void AddShared() noexcept {
+    counts_.fetch_add(kShared, std::memory_order_relaxed);
+  }
+ 
+  bool ReleaseShared() noexcept {
+    return Shared(counts_.fetch_sub(kShared, std::memory_order_acq_rel)) == 1;
+  }
+ 
+  // Never revives an object whose count has already reached zero.
+  bool TryAddShared() noexcept {
+    std::uint64_t counts = counts_.load(std::memory_order_relaxed);
+    while (Shared(counts) != 0) {
+      if (counts_.compare_exchange_weak(counts, counts + kShared, std::memory_order_acq_rel,
+                                        std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+ 
+  void AddWeak() noexcept {
+    counts_.fetch_add(kWeak, std::memory_order_relaxed);
+  }
+ 
+  bool ReleaseWeak() noexcept {
+    return (counts_.fetch_sub(kWeak, std::memory_order_acq_rel) >> 32) == 1;
+  }
+ 
+  bool WeakUnique() const noexcept {
+    return (counts_.load(std::memory_order_acquire) >> 32) == 1;
+  }
+ 
+  size_t SharedCount() const noexcept {
+    return Shared(counts_.load(std::memory_order_relaxed));
+  }
+ 
+ private:
+  static constexpr std::uint64_t kShared = 1;
+  static constexpr std::uint64_t kWeak = std::uint64_t(1) << 32;
+ 
+  std::atomic<std::uint64_t> counts_ = kShared | kWeak;
+ 
+  static std::uint32_t Shared(std::uint64_t counts) noexcept {
+    return static_cast<std::uint32_t>(counts);
+  }
+};
+ 
+// Biased reference counting. The thread that creates the block owns it and
+// counts its own references with plain loads and stores; other threads add
+// and drop references on an atomic word that goes negative when they release
+// references the owner made. The two counts merge when the owner's count
+// reaches zero, or when another thread drives the atomic count negative and
+// queues the block for its owner, which merges on its next release or in
+// MergePending(). After the owner thread exits, the thread that would have
+// queued the block merges it itself. A merged block is counted in the atomic
+// word alone, by every thread.
+class BiasedRefCount {
+ public:
+  BiasedRefCount();
+ 
+  BiasedRefCount(const BiasedRefCount&) = delete;
+ 
+  BiasedRefCount& operator=(const BiasedRefCount&) = delete;
  
+  void AddShared() noexcept {
+    if (IsOwner()) {
+      biased_count_.store(biased_count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    } else {
+      shared_.fetch_add(kOne, std::memory_order_relaxed);
+    }
+  }
+ 
+  bool ReleaseShared() noexcept;
+ 
+  // Fails once the count, the owner's share included, is down to zero, even
+  // while the block still waits in its owner's queue to be destroyed: no
+  // reference is left to revive it with, and expired() already reports it.
+  bool TryAddShared() noexcept {
+    std::int64_t shared = shared_.load(std::memory_order_relaxed);
+    if (IsOwner()) {
+      if (Total(shared) <= 0) {
+        return false;
+      }
+      AddShared();
+      return true;
+    }
+    while (Total(shared) > 0) {
+      if (shared_.compare_exchange_weak(shared, shared + kOne, std::memory_order_acq_rel,
+                                        std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+ 
+  void AddWeak() noexcept {
+    weak_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+ 
+  bool ReleaseWeak() noexcept {
+    return weak_count_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+ 
+  bool WeakUnique() const noexcept {
+    return weak_count_.load(std::memory_order_acquire) == 1;
+  }
+ 
+  size_t SharedCount() const noexcept {
+    std::int64_t count = Total(shared_.load(std::memory_order_relaxed));
+    return count > 0 ? static_cast<size_t>(count) : 0;
+  }
+ 
+  // Merges the blocks other threads have queued for the calling thread.
+  static void MergePending();
+ 
+ private:
+  class MergeQueue;
+ 
+  // shared_ holds the count above two flag bits: kMerged once the biased
+  // count has been folded in, kQueued while the block sits in a MergeQueue.
+  // Only the queue may destroy a queued block.
+  static constexpr std::int64_t kMerged = 1;
+  static constexpr std::int64_t kQueued = 2;
+  static constexpr std::int64_t kOne = 4;
+ 
+  MergeQueue* const queue_;
+  std::atomic<std::uint32_t> biased_count_;
+  std::atomic<std::uint32_t> weak_count_ = 1;
+  std::atomic<std::int64_t> shared_;
+  BiasedRefCount* next_queued_ = nullptr;
+ 
+  static std::int64_t Count(std::int64_t shared) noexcept {
+    return shared >> 2;
+  }
+ 
+  // The count with the owner's share added until it has been merged. Until
+  // then the atomic part goes negative for references the owner made and
+  // others released, so only the sum tells whether any is left.
+  std::int64_t Total(std::int64_t shared) const noexcept {
+    std::int64_t count = Count(shared);
+    if ((shared & kMerged) == 0) {
+      count += biased_count_.load(std::memory_order_relaxed);
+    }
+    return count;
+  }
+ 
+  // The owner is the only thread that sets kMerged while it is alive, so its
+  // relaxed read of the flag is exact.
+  bool IsOwner() const noexcept;
+ 
+  // Folds the biased count in and clears kQueued. Runs on the owner, or on
+  // any thread once the owner has exited. Returns true when no reference is
+  // left. biased_count_ keeps its value: Total() ignores it once kMerged is
+  // set, and a reader that loaded shared_ before the merge still adds it.
+  bool Merge() noexcept {
+    std::int64_t biased = biased_count_.load(std::memory_order_relaxed);
+    std::int64_t shared = shared_.load(std::memory_order_relaxed);
+    std::int64_t merged;
+    do {
+      merged = ((shared + biased * kOne) | kMerged) & ~kQueued;
+    } while (!shared_.compare_exchange_weak(shared, merged, std::memory_order_acq_rel,
+                                            std::memory_order_relaxed));
+    return Count(merged) == 0;
+  }
+};
+ 
+// Blocks queued for one owner thread, as an atomic stack linked through the
+// blocks. Closed when the owner exits; pushes fail from then on. Counted by
+// the owner and by every block that may still be queued on it.
+class BiasedRefCount::MergeQueue {
+ public:
+  // Null while the calling thread's storage is being destroyed.
+  static MergeQueue* Local() {
+    if (local_ == nullptr && !torn_down_) {
+      local_ = new MergeQueue();
+      owner_.queue = local_;
+    }
+    return local_;
+  }
+ 
+  static bool IsLocal(const MergeQueue* queue) noexcept {
+    return queue == local_;
+  }
+ 
+  void AddRef() noexcept {
+    refs_.fetch_add(1, std::memory_order_relaxed);
+  }
+ 
+  void Unref() noexcept {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+ 
+  bool HasPending() const noexcept {
+    return head_.load(std::memory_order_relaxed) != nullptr;
+  }
+ 
+  // Acquiring the closed marker makes the exited owner's biased counts
+  // visible to the caller.
+  bool Push(BiasedRefCount* block) noexcept {
+    BiasedRefCount* head = head_.load(std::memory_order_acquire);
+    do {
+      if (head == Closed()) {
+        return false;
+      }
+      block->next_queued_ = head;
+    } while (!head_.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_acquire));
+    return true;
+  }
+ 
+  void Drain() {
+    Merge(head_.exchange(nullptr, std::memory_order_acquire));
+  }
+ 
+ private:
+  // Zero-initialized as a thread_local; a member initializer here would not
+  // be usable before MergeQueue is complete.
+  struct Owner {
+    MergeQueue* queue;
+ 
+    // Blocks released while the queue drains take the non-owner path and
+    // either land in the queue before it closes or merge themselves.
+    ~Owner() {
+      local_ = nullptr;
+      torn_down_ = true;
+      if (queue != nullptr) {
+        queue->Merge(queue->head_.exchange(Closed(), std::memory_order_acq_rel));
+        queue->Unref();
+      }
+    }
+  };
+ 
+  static inline thread_local MergeQueue* local_ = nullptr;
+  static inline thread_local bool torn_down_ = false;
+  static inline thread_local Owner owner_;
+ 
+  std::atomic<BiasedRefCount*> head_ = nullptr;
+  std::atomic<size_t> refs_ = 1;
+ 
+  static BiasedRefCount* Closed() noexcept {
+    return reinterpret_cast<BiasedRefCount*>(alignof(BiasedRefCount));
+  }
+ 
+  void Merge(BiasedRefCount* blocks);
+};
+ 
+inline BiasedRefCount::BiasedRefCount() : queue_(MergeQueue::Local()) {
+  if (queue_ != nullptr) {
+    queue_->AddRef();
+    biased_count_.store(1, std::memory_order_relaxed);
+    shared_.store(0, std::memory_order_relaxed);
+  } else {
+    biased_count_.store(0, std::memory_order_relaxed);
+    shared_.store(kOne | kMerged, std::memory_order_relaxed);
+  }
+}
+ 
+inline bool BiasedRefCount::IsOwner() const noexcept {
+  return MergeQueue::IsLocal(queue_) && (shared_.load(std::memory_order_relaxed) & kMerged) == 0;
+}
+ 
+inline bool BiasedRefCount::ReleaseShared() noexcept {
+  if (IsOwner()) {
+    std::uint32_t biased = biased_count_.load(std::memory_order_relaxed) - 1;
+    biased_count_.store(biased, std::memory_order_relaxed);
+    bool last = false;
+    if (biased == 0) {
+      std::int64_t shared = shared_.fetch_or(kMerged, std::memory_order_acq_rel);
+      if ((shared & kQueued) == 0) {
+        queue_->Unref();
+        last = Count(shared) == 0;
+      }
+    }
+    if (queue_->HasPending()) {
+      queue_->Drain();
+    }
+    return last;
+  }
+  // kMerged is never cleared, so a merged block cannot need queueing.
+  std::int64_t shared = shared_.load(std::memory_order_relaxed);
+  if ((shared & kMerged) != 0) {
+    std::int64_t released = shared_.fetch_sub(kOne, std::memory_order_acq_rel) - kOne;
+    return (released & kQueued) == 0 && Count(released) == 0;
+  }
+  std::int64_t released;
+  do {
+    released = shared - kOne;
+    if ((shared & (kMerged | kQueued)) == 0 && Count(released) < 0) {
+      released |= kQueued;
+    }
+  } while (!shared_.compare_exchange_weak(shared, released, std::memory_order_acq_rel,
+                                          std::memory_order_relaxed));
+  if ((released & kQueued) != 0 && (shared & kQueued) == 0) {
+    MergeQueue* queue = queue_;
+    if (queue->Push(this)) {
+      return false;
+    }
+    bool last = Merge();
+    queue->Unref();
+    return last;
+  }
+  return (released & (kMerged | kQueued)) == kMerged && Count(released) == 0;
+}
+ 
+inline void BiasedRefCount::MergePending() {
+  if (MergeQueue* queue = MergeQueue::Local(); queue != nullptr && queue->HasPending()) {
+    queue->Drain();
+  }
+}
+ 
+// Per-thread slab pools for control blocks of one size. Slabs are aligned to
+// their size, so a block finds its pool through the slab header without any
+// per-block overhead. The owning thread allocates and frees through a plain
+// free list; other threads push freed blocks onto an atomic stack that the
+// owner takes over once its own list runs dry. A pool is counted by its
+// owning thread and by every live block, so it outlives the thread that
+// created it as long as blocks from it are still in use.
+template <size_t Size, size_t Align>
+class ControlBlockPool {
+ public:
+  static void* Allocate() {
+    ControlBlockPool* pool = local_;
+    bool orphan = false;
+    if (pool == nullptr) {
+      pool = new ControlBlockPool();
+      if (torn_down_) {
+        // Allocations made while this thread's storage is being destroyed
+        // get a pool of their own that nobody owns.
+        orphan = true;
+      } else {
+        owner_.pool = pool;
+        local_ = pool;
+      }
+    }
+    void* slot = pool->Pop();
+    pool->refs_.fetch_add(1, std::memory_order_relaxed);
+    if (orphan) {
+      pool->Unref();
+    }
+    return slot;
+  }
+ 
+  static void Deallocate(void* ptr) noexcept {
+    ControlBlockPool* pool = SlabOf(ptr)->pool;
+    auto slot = static_cast<FreeSlot*>(ptr);
+    if (pool == local_) {
+      slot->next = pool->free_;
+      pool->free_ = slot;
+    } else {
+      slot->next = pool->remote_.load(std::memory_order_relaxed);
+      while (!pool->remote_.compare_exchange_weak(slot->next, slot, std::memory_order_release,
+                                                  std::memory_order_relaxed)) {
+      }
+    }
+    pool->Unref();
+  }
+ 
+ private:
+  struct FreeSlot {
+    FreeSlot* next;
+  };
+ 
+  struct Slab {
+    ControlBlockPool* pool;
+    Slab* next;
+  };
+ 
+  struct Owner {
+    ControlBlockPool* pool = nullptr;
+ 
+    ~Owner() {
+      local_ = nullptr;
+      torn_down_ = true;
+      if (pool != nullptr) {
+        pool->Unref();
+      }
+    }
+  };
+ 
+  static constexpr size_t kSlabBytes = 16 * 1024;
+  static constexpr size_t kSlot = (std::max(Size, sizeof(FreeSlot)) + Align - 1) / Align * Align;
+  static constexpr size_t kFirstSlot = (sizeof(Slab) + Align - 1) / Align * Align;
+  static_assert(Align <= kSlabBytes && kFirstSlot + kSlot <= kSlabBytes);
+ 
+  static inline thread_local ControlBlockPool* local_ = nullptr;
+  static inline thread_local bool torn_down_ = false;
+  static inline thread_local Owner owner_;
+ 
+  FreeSlot* free_ = nullptr;
+  char* cursor_ = nullptr;
+  char* end_ = nullptr;
+  Slab* slabs_ = nullptr;
+  std::atomic<FreeSlot*> remote_ = nullptr;
+  std::atomic<size_t> refs_ = 1;
+ 
+  ~ControlBlockPool() {
+    while (slabs_ != nullptr) {
+      Slab* next = slabs_->next;
+      ::operator delete(slabs_, std::align_val_t(kSlabBytes));
+      slabs_ = next;
+    }
+  }
+ 
+  static Slab* SlabOf(void* ptr) noexcept {
+    return reinterpret_cast<Slab*>(reinterpret_cast<std::uintptr_t>(ptr) & ~(kSlabBytes - 1));
+  }
+ 
+  void* Pop() {
+    if (free_ == nullptr) {
+      free_ = remote_.exchange(nullptr, std::memory_order_acquire);
+    }
+    if (free_ != nullptr) {
+      FreeSlot* slot = free_;
+      free_ = slot->next;
+      return slot;
+    }
+    if (cursor_ + kSlot > end_) {
+      auto slab = static_cast<Slab*>(::operator new(kSlabBytes, std::align_val_t(kSlabBytes)));
+      slab->pool = this;
+      slab->next = slabs_;
+      slabs_ = slab;
+      cursor_ = reinterpret_cast<char*>(slab) + kFirstSlot;
+      end_ = reinterpret_cast<char*>(slab) + kSlabBytes;
+    }
+    cursor_ += kSlot;
+    return cursor_ - kSlot;
+  }
+ 
+  void Unref() noexcept {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+};
+ 
+// Stateless allocator that serves single control blocks from
+// ControlBlockPool. SharedPtr uses it for the blocks it creates when adopting
+// a raw pointer.
 template <typename T>
+struct PooledBlockAllocator {
+  using value_type = T;
+ 
+  PooledBlockAllocator() noexcept = default;
+ 
+  template <typename U>
+  PooledBlockAllocator(const PooledBlockAllocator<U>&) noexcept {
+  }
+ 
+  T* allocate(size_t n) {
+    if (n != 1) {
+      return std::allocator<T>().allocate(n);
+    }
+    return static_cast<T*>(ControlBlockPool<sizeof(T), alignof(T)>::Allocate());
+  }
+ 
+  void deallocate(T* ptr, size_t n) noexcept {
+    if (n != 1) {
+      std::allocator<T>().deallocate(ptr, n);
+      return;
+    }
+    ControlBlockPool<sizeof(T), alignof(T)>::Deallocate(ptr);
+  }
+ 
+  template <typename U>
+  bool operator==(const PooledBlockAllocator<U>&) const noexcept {
+    return true;
+  }
+};
+ 
+// Refcount instrumentation is compiled in only with
+// -DSHARED_PTR_INSTRUMENTATION; otherwise control blocks carry no probe and
+// the reports below print nothing.
+#ifdef SHARED_PTR_INSTRUMENTATION
+inline constexpr bool kSharedPtrInstrumentation = true;
+#else
+inline constexpr bool kSharedPtrInstrumentation = false;
+#endif
+ 
+// Counters for every control block created for one object type, under any
+// policy. Types register themselves on their first block.
+struct SharedPtrTypeStats {
+  // Bucket i counts objects destroyed less than 2^i microseconds after their
+  // block was created; the last bucket takes everything older.
+  static constexpr size_t kLifetimeBuckets = 32;
+ 
+  // Demangled where the compiler provides abi::__cxa_demangle.
+  std::string type_name;
+  std::atomic<size_t> blocks = 0;
+  std::atomic<size_t> live = 0;
+  std::atomic<size_t> peak_live = 0;
+  std::atomic<size_t> increments = 0;
+  std::atomic<size_t> decrements = 0;
+  std::atomic<size_t> weak_locks = 0;
+  std::atomic<size_t> failed_weak_locks = 0;
+  std::atomic<size_t> peak_use_count = 0;
+  std::atomic<size_t> lifetimes[kLifetimeBuckets] = {};
+  SharedPtrTypeStats* next = nullptr;
+ 
+  template <typename U>
+  static SharedPtrTypeStats& For() {
+    static SharedPtrTypeStats stats(typeid(U).name());
+    return stats;
+  }
+ 
+  static void Max(std::atomic<size_t>& counter, size_t value) noexcept {
+    size_t current = counter.load(std::memory_order_relaxed);
+    while (current < value && !counter.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+  }
+ 
+  void report(std::ostream& out) const {
+    out << type_name << ": blocks " << blocks << ", live " << live << ", peak live " << peak_live
+        << ", increments " << increments << ", decrements " << decrements << ", weak locks " << weak_locks
+        << " (" << failed_weak_locks << " failed), peak use_count " << peak_use_count << '\n';
+    for (size_t i = 0; i < kLifetimeBuckets; ++i) {
+      if (size_t count = lifetimes[i].load(std::memory_order_relaxed)) {
+        out << "  lifetime " << (i + 1 < kLifetimeBuckets ? "< " : ">= ")
+            << (std::uint64_t(1) << (i + 1 < kLifetimeBuckets ? i : i - 1)) << "us: " << count << '\n';
+      }
+    }
+  }
+ 
+  static std::mutex& RegistryMutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+ 
+  static SharedPtrTypeStats*& Registry() {
+    static SharedPtrTypeStats* head = nullptr;
+    return head;
+  }
+ 
+ private:
+  explicit SharedPtrTypeStats(const char* mangled) : type_name(Demangle(mangled)) {
+    std::lock_guard lock(RegistryMutex());
+    next = Registry();
+    Registry() = this;
+  }
+ 
+  static std::string Demangle(const char* mangled) {
+#ifdef __GNUG__
+    int status = 0;
+    std::unique_ptr<char, void (*)(void*)> name(abi::__cxa_demangle(mangled, nullptr, nullptr, &status), std::free);
+    if (status == 0) {
+      return name.get();
+    }
+#endif
+    return mangled;
+  }
+};
+ 
+// Per-block half of the instrumentation, embedded in IBaseControlBlock. Every
+// block with a probe sits in a global list until it is deallocated, so that
+// the survivors of a teardown, typically reference cycles, can be listed.
+template <bool Enabled = kSharedPtrInstrumentation>
+class ControlBlockProbe {
+ public:
+  using SharedCount = size_t (*)(const void*);
+ 
+  void OnCreate(SharedPtrTypeStats& type, const void* block, SharedCount shared_count) {
+    type_ = &type;
+    block_ = block;
+    shared_count_ = shared_count;
+    created_ = std::chrono::steady_clock::now();
+    type.blocks.fetch_add(1, std::memory_order_relaxed);
+    // Every block starts out with one shared owner.
+    SharedPtrTypeStats::Max(type.peak_use_count, 1);
+    SharedPtrTypeStats::Max(type.peak_live, type.live.fetch_add(1, std::memory_order_relaxed) + 1);
+    std::lock_guard lock(Mutex());
+    prev_ = nullptr;
+    next_ = Head();
+    if (next_ != nullptr) {
+      next_->prev_ = this;
+    }
+    Head() = this;
+  }
+ 
+  void OnIncrease(size_t use_count) noexcept {
+    if (type_ != nullptr) {
+      type_->increments.fetch_add(1, std::memory_order_relaxed);
+      SharedPtrTypeStats::Max(type_->peak_use_count, use_count);
+    }
+  }
+ 
+  void OnDecrease() noexcept {
+    if (type_ != nullptr) {
+      type_->decrements.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+ 
+  void OnWeakLock(bool locked) noexcept {
+    if (type_ != nullptr) {
+      (locked ? type_->weak_locks : type_->failed_weak_locks).fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+ 
+  void OnDestroyObject() noexcept {
+    if (type_ == nullptr) {
+      return;
+    }
+    auto age = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - created_);
+    size_t bucket = 0;
+    while (bucket + 1 < SharedPtrTypeStats::kLifetimeBuckets && (std::uint64_t(1) << bucket) <= std::uint64_t(age.count())) {
+      ++bucket;
+    }
+    type_->lifetimes[bucket].fetch_add(1, std::memory_order_relaxed);
+    type_->live.fetch_sub(1, std::memory_order_relaxed);
+  }
+ 
+  void OnDeallocate() noexcept {
+    if (type_ == nullptr) {
+      return;
+    }
+    std::lock_guard lock(Mutex());
+    (prev_ != nullptr ? prev_->next_ : Head()) = next_;
+    if (next_ != nullptr) {
+      next_->prev_ = prev_;
+    }
+  }
+ 
+  static void Dump(std::ostream& out) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard lock(Mutex());
+    for (ControlBlockProbe* probe = Head(); probe != nullptr; probe = probe->next_) {
+      out << probe->type_->type_name << " block " << probe->block_ << ": use_count " << probe->shared_count_(probe->block_)
+          << ", age " << std::chrono::duration_cast<std::chrono::microseconds>(now - probe->created_).count() << "us\n";
+    }
+  }
+ 
+ private:
+  SharedPtrTypeStats* type_ = nullptr;
+  const void* block_ = nullptr;
+  SharedCount shared_count_ = nullptr;
+  std::chrono::steady_clock::time_point created_;
+  ControlBlockProbe* prev_ = nullptr;
+  ControlBlockProbe* next_ = nullptr;
+ 
+  static std::mutex& Mutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+ 
+  static ControlBlockProbe*& Head() {
+    static ControlBlockProbe* head = nullptr;
+    return head;
+  }
+};
+ 
+template <>
+class ControlBlockProbe<false> {
+ public:
+  using SharedCount = size_t (*)(const void*);
+ 
+  void OnCreate(SharedPtrTypeStats&, const void*, SharedCount) noexcept {
+  }
+ 
+  void OnIncrease(size_t) noexcept {
+  }
+ 
+  void OnDecrease() noexcept {
+  }
+ 
+  void OnWeakLock(bool) noexcept {
+  }
+ 
+  void OnDestroyObject() noexcept {
+  }
+ 
+  void OnDeallocate() noexcept {
+  }
+ 
+  static void Dump(std::ostream&) {
+  }
+};
+ 
+// One paragraph per object type that has had a control block, most
+// recently registered first.
+inline void reportSharedPtrTypes(std::ostream& out) {
+  if constexpr (kSharedPtrInstrumentation) {
+    std::lock_guard lock(SharedPtrTypeStats::RegistryMutex());
+    for (SharedPtrTypeStats* stats = SharedPtrTypeStats::Registry(); stats != nullptr; stats = stats->next) {
+      stats->report(out);
+    }
+  }
+}
+ 
+// Lists every control block not yet deallocated. Blocks with use_count 0 are
+// only kept by WeakPtrs.
+inline void dumpLiveControlBlocks(std::ostream& out) {
+  ControlBlockProbe<>::Dump(out);
+}
+ 
+template <typename T, typename Policy = AtomicRefCount>
+class SharedPtr;
+ 
+template <typename T, typename Policy = AtomicRefCount>
 class WeakPtr;
  
-template <typename T>
+template <typename T, typename Policy = AtomicRefCount>
 class EnableSharedFromThis;
  
-struct IBaseControlBlock {
-  size_t shared_count;
-  size_t weak_count;
+template <typename T, typename Policy = AtomicRefCount>
+class AtomicSharedPtr;
+ 
+template <typename Storage>
+class SharedArena;
+ 
+enum class ControlBlockOp {
+  kDestroyObject,
+  kDeallocate,
+  kDestroyAndDeallocate,
+};
+ 
+// Not polymorphic: each concrete block registers one function that knows its
+// type, so a block header is the counts plus a single pointer.
+template <typename Policy>
+struct IBaseControlBlock : Policy {
+  using Dispatch = void (*)(IBaseControlBlock*, ControlBlockOp);
+ 
+  Dispatch dispatch;
+  [[no_unique_address]] ControlBlockProbe<> probe;
+ 
+  explicit IBaseControlBlock(Dispatch dispatch) noexcept : dispatch(dispatch) {
+  }
+ 
+  // Called once the block and its object are fully constructed.
+  template <typename U>
+  void Track() {
+    if constexpr (kSharedPtrInstrumentation) {
+      probe.OnCreate(SharedPtrTypeStats::For<std::remove_cv_t<U>>(), this, [](const void* block) {
+        return static_cast<const IBaseControlBlock*>(block)->SharedCount();
+      });
+    }
+  }
+ 
+  void IncreaseShared() noexcept {
+    this->AddShared();
+    if constexpr (kSharedPtrInstrumentation) {
+      probe.OnIncrease(this->SharedCount());
+    }
+  }
  
-  IBaseControlBlock(size_t shared_count, size_t weak_count) : shared_count(shared_count), weak_count(weak_count) {
+  bool TryIncreaseShared() noexcept {
+    bool locked = this->TryAddShared();
+    if constexpr (kSharedPtrInstrumentation) {
+      probe.OnWeakLock(locked);
+      if (locked) {
+        probe.OnIncrease(this->SharedCount());
+      }
+    }
+    return locked;
+  }
+ 
+  void SharedDestroy() {
+    dispatch(this, ControlBlockOp::kDestroyObject);
+  }
+ 
+  void WeakDestroy() {
+    probe.OnDeallocate();
+    dispatch(this, ControlBlockOp::kDeallocate);
+  }
+ 
+  void DecreaseShared() {
+    probe.OnDecrease();
+    if (this->ReleaseShared()) {
+      ReleaseObject();
+    }
   }
  
-  virtual void SharedDestroy() = 0;
-  virtual void WeakDestroy() = 0;
-  virtual ~IBaseControlBlock() = default;
+  // Runs once the last shared owner is gone. Without outstanding WeakPtrs it
+  // tears everything down in a single call and skips the weak decrement.
+  void ReleaseObject() {
+    probe.OnDestroyObject();
+    if (this->WeakUnique()) {
+      probe.OnDeallocate();
+      dispatch(this, ControlBlockOp::kDestroyAndDeallocate);
+      return;
+    }
+    SharedDestroy();
+    DecreaseWeak();
+  }
+ 
+  void DecreaseWeak() {
+    if (this->ReleaseWeak()) {
+      WeakDestroy();
+    }
+  }
 };
  
-template <typename T>
+inline void BiasedRefCount::MergeQueue::Merge(BiasedRefCount* blocks) {
+  while (blocks != nullptr && blocks != Closed()) {
+    BiasedRefCount* block = blocks;
+    blocks = block->next_queued_;
+    bool last = block->Merge();
+    Unref();
+    if (last) {
+      static_cast<IBaseControlBlock<BiasedRefCount>*>(block)->ReleaseObject();
+    }
+  }
+}
+ 
+template <typename T, typename Policy>
 class SharedPtr {
+ public:
+  using element_type = std::remove_extent_t<T>;
+ 
  private:
+  using ControlBlock = IBaseControlBlock<Policy>;
+ 
   template <typename U = T, typename Alloc = std::allocator<U>>
-  struct MadeSharedControlBlock : IBaseControlBlock {
+  struct MadeSharedControlBlock : ControlBlock {
     using MadeSharedCBAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<MadeSharedControlBlock>;
     using MadeSharedCBTraits = std::allocator_traits<MadeSharedCBAlloc>;
-    MadeSharedCBAlloc alloc;
+    [[no_unique_address]] MadeSharedCBAlloc alloc;
     alignas(U) char char_ptr[sizeof(U)];
  
-    void SharedDestroy() override {
-      Alloc default_alloc = alloc;
-      std::allocator_traits<Alloc>::destroy(default_alloc, reinterpret_cast<U*>(char_ptr));
- 
-      if (this->weak_count == 0) {
-        this->WeakDestroy();
-      }
-    }
- 
-    void WeakDestroy() override {
-      MadeSharedCBTraits::deallocate(alloc, this, 1);
+    explicit MadeSharedControlBlock(Alloc alloc) : ControlBlock(&Dispatch), alloc(alloc) {
     }
  
-    MadeSharedControlBlock(size_t shared_count, size_t weak_count, Alloc alloc)
-        : IBaseControlBlock(shared_count, weak_count), alloc(alloc) {
+    static void Dispatch(ControlBlock* base, ControlBlockOp op) {
+      auto self = static_cast<MadeSharedControlBlock*>(base);
+      if (op != ControlBlockOp::kDeallocate) {
+        Alloc default_alloc = self->alloc;
+        std::allocator_traits<Alloc>::destroy(default_alloc, reinterpret_cast<U*>(self->char_ptr));
+      }
+      if (op != ControlBlockOp::kDestroyObject) {
+        MadeSharedCBAlloc alloc = self->alloc;
+        self->~MadeSharedControlBlock();
+        MadeSharedCBTraits::deallocate(alloc, self, 1);
+      }
     }
   };
  
   template <typename U = T, typename Deleter = std::default_delete<U>, typename Alloc = std::allocator<U>>
-  struct DeleterControlBlock : IBaseControlBlock {
+  struct DeleterControlBlock : ControlBlock {
     using DeleterCBAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<DeleterControlBlock>;
     using DeleterCBTraits = std::allocator_traits<DeleterCBAlloc>;
-    Deleter deleter;
-    DeleterCBAlloc allocator;
+    [[no_unique_address]] Deleter deleter;
+    [[no_unique_address]] DeleterCBAlloc allocator;
     U* ptr;
  
-    DeleterControlBlock(size_t shared_count, size_t weak_count, Deleter deleter, Alloc alloc, U* ptr)
-        : IBaseControlBlock(shared_count, weak_count), deleter(deleter), allocator(alloc), ptr(ptr) {
+    DeleterControlBlock(Deleter deleter, Alloc alloc, U* ptr)
+        : ControlBlock(&Dispatch), deleter(deleter), allocator(alloc), ptr(ptr) {
     }
  
-    void SharedDestroy() override {
-      deleter(ptr);
+    static void Dispatch(ControlBlock* base, ControlBlockOp op) {
+      auto self = static_cast<DeleterControlBlock*>(base);
+      if (op != ControlBlockOp::kDeallocate) {
+        self->deleter(self->ptr);
+      }
+      if (op != ControlBlockOp::kDestroyObject) {
+        DeleterCBAlloc allocator = self->allocator;
+        self->~DeleterControlBlock();
+        DeleterCBTraits::deallocate(allocator, self, 1);
+      }
+    }
+  };
+ 
+  template <size_t Align>
+  struct alignas(Align) AlignedUnit {
+    char bytes[Align];
+  };
+ 
+  // Header of a makeShared<T[]> allocation; the elements follow it in the
+  // same allocation, which is made of whole AlignedUnits.
+  template <typename Alloc>
+  struct ArrayControlBlock : ControlBlock {
+    using ElementAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<element_type>;
+    using Unit = AlignedUnit<std::max(alignof(element_type), alignof(std::max_align_t))>;
+    using UnitAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Unit>;
+    using UnitTraits = std::allocator_traits<UnitAlloc>;
+    [[no_unique_address]] UnitAlloc alloc;
+    size_t count;
+ 
+    ArrayControlBlock(Alloc alloc, size_t count) : ControlBlock(&Dispatch), alloc(alloc), count(count) {
+    }
  
-      if (this->weak_count == 0) {
-        this->WeakDestroy();
+    static constexpr size_t Offset() noexcept {
+      return (sizeof(ArrayControlBlock) + alignof(element_type) - 1) / alignof(element_type) * alignof(element_type);
+    }
+ 
+    static size_t Units(size_t count) {
+      if (count > (static_cast<size_t>(-1) - Offset() - sizeof(Unit)) / sizeof(element_type)) {
+        throw std::bad_array_new_length();
       }
+      return (Offset() + count * sizeof(element_type) + sizeof(Unit) - 1) / sizeof(Unit);
+    }
+ 
+    element_type* Elements() noexcept {
+      return reinterpret_cast<element_type*>(reinterpret_cast<char*>(this) + Offset());
     }
  
-    void WeakDestroy() override {
-      DeleterCBTraits::deallocate(allocator, this, 1);
+    // Destroys the first count elements, last one first.
+    void DestroyElements(size_t count) noexcept {
+      ElementAlloc element_alloc(alloc);
+      while (count > 0) {
+        std::allocator_traits<ElementAlloc>::destroy(element_alloc, Elements() + --count);
+      }
     }
  
-    ~DeleterControlBlock() override = default;
+    static void Dispatch(ControlBlock* base, ControlBlockOp op) {
+      auto self = static_cast<ArrayControlBlock*>(base);
+      if (op != ControlBlockOp::kDeallocate) {
+        self->DestroyElements(self->count);
+      }
+      if (op != ControlBlockOp::kDestroyObject) {
+        UnitAlloc alloc = self->alloc;
+        size_t units = Units(self->count);
+        self->~ArrayControlBlock();
+        UnitTraits::deallocate(alloc, reinterpret_cast<Unit*>(self), units);
+      }
+    }
   };
  
  public:
@@ -82,7 +989,7 @@ class SharedPtr {
  
   SharedPtr(const SharedPtr& other) noexcept : block_(other.block_), ptr_(other.ptr_) {
     if (block_ != nullptr) {
-      ++block_->shared_count;
+      block_->IncreaseShared();
     }
   }
  
@@ -96,23 +1003,25 @@ class SharedPtr {
   }
  
   SharedPtr& operator=(SharedPtr&& other) noexcept {
-    return this->operator= <T>(std::forward<SharedPtr<T>>(other));
+    return this->operator= <T>(std::move(other));
   }
  
   // Base constructor
   template <typename U = T, typename Deleter, typename Alloc>
-  SharedPtr(U* ptr, Deleter deleter, Alloc alloc) : ptr_(static_cast<T*>(ptr)) {
+  SharedPtr(U* ptr, Deleter deleter, Alloc alloc) : ptr_(static_cast<element_type*>(ptr)) {
     typename DeleterControlBlock<U, Deleter, Alloc>::DeleterCBAlloc alloc1(alloc);
-    auto block = DeleterControlBlock<U, Deleter, Alloc>::DeleterCBTraits::allocate(alloc1, 1);
-    new (block) DeleterControlBlock<U, Deleter, Alloc>(1, 0, deleter, alloc, ptr);
- 
-    block_ = static_cast<IBaseControlBlock*>(block);
- 
-    if constexpr (std::is_base_of_v<EnableSharedFromThis<U>, U>) {
-      auto enable_shared_ptr = static_cast<EnableSharedFromThis<U>*>(ptr);
-      enable_shared_ptr->ptr_ = ptr;
-      enable_shared_ptr->block_ = block;
+    typename DeleterControlBlock<U, Deleter, Alloc>::DeleterCBTraits::pointer block;
+    try {
+      block = DeleterControlBlock<U, Deleter, Alloc>::DeleterCBTraits::allocate(alloc1, 1);
+    } catch (...) {
+      deleter(ptr);
+      throw;
     }
+    new (block) DeleterControlBlock<U, Deleter, Alloc>(deleter, alloc, ptr);
+ 
+    block_ = static_cast<ControlBlock*>(block);
+    block_->template Track<U>();
+    EnableSharedFromThisFor(ptr);
   }
  
   template <typename U = T>
@@ -125,59 +1034,74 @@ class SharedPtr {
   }
  
   template <typename U = T, typename Deleter>
-  SharedPtr(U* ptr, Deleter deleter) : SharedPtr(ptr, deleter, std::allocator<U>()) {
+  SharedPtr(U* ptr, Deleter deleter) : SharedPtr(ptr, deleter, PooledBlockAllocator<U>()) {
   }
  
-  template <typename U = T>
-  SharedPtr(U* ptr) : SharedPtr(ptr, std::default_delete<U>(), std::allocator<U>()) {
+  // Arrays are released with delete[].
+  template <typename U = element_type>
+  SharedPtr(U* ptr)
+      : SharedPtr(ptr, std::conditional_t<std::is_array_v<T>, std::default_delete<U[]>, std::default_delete<U>>(),
+                  PooledBlockAllocator<U>()) {
   }
  
   template <typename U = T>
-  SharedPtr(const SharedPtr<U>& shared_ptr) noexcept
-      : block_(const_cast<IBaseControlBlock*>(shared_ptr.block_)), ptr_(static_cast<T*>(shared_ptr.ptr_)) {
-    ++block_->shared_count;
+    requires std::is_convertible_v<typename SharedPtr<U, Policy>::element_type*, element_type*>
+  SharedPtr(const SharedPtr<U, Policy>& shared_ptr) noexcept : SharedPtr(shared_ptr, shared_ptr.ptr_) {
   }
  
   template <typename U = T>
-  SharedPtr(SharedPtr<U>&& shared_ptr) noexcept
-      : block_(const_cast<IBaseControlBlock*>(shared_ptr.block_)), ptr_(static_cast<T*>(shared_ptr.ptr_)) {
-    shared_ptr.ptr_ = nullptr;
-    shared_ptr.block_ = nullptr;
+    requires std::is_convertible_v<typename SharedPtr<U, Policy>::element_type*, element_type*>
+  SharedPtr(SharedPtr<U, Policy>&& shared_ptr) noexcept : SharedPtr(std::move(shared_ptr), shared_ptr.ptr_) {
   }
  
-  template <typename U = T>
-  SharedPtr& operator=(const SharedPtr<U>& other) {
-    auto other_ptr = static_cast<T*>(other.ptr_);
-    if (other_ptr == ptr_) {
-      return *this;
+  // Aliasing constructors: share ownership with owner but point at ptr,
+  // typically a member of the owned object. No allocation takes place.
+  template <typename U>
+  SharedPtr(const SharedPtr<U, Policy>& owner, element_type* ptr) noexcept : block_(owner.block_), ptr_(ptr) {
+    if (block_ != nullptr) {
+      block_->IncreaseShared();
     }
+  }
  
-    DecreaseAndDestroy();
+  template <typename U>
+  SharedPtr(SharedPtr<U, Policy>&& owner, element_type* ptr) noexcept : block_(owner.block_), ptr_(ptr) {
+    owner.ptr_ = nullptr;
+    owner.block_ = nullptr;
+  }
  
+  // Pointers that alias the same block differ only in ptr_, so ownership is
+  // decided by the block alone.
+  template <typename U = T>
+  SharedPtr& operator=(const SharedPtr<U, Policy>& other) {
+    auto other_ptr = static_cast<element_type*>(other.ptr_);
+    auto other_block = other.block_;
+    if (other_block != block_) {
+      if (other_block != nullptr) {
+        other_block->IncreaseShared();
+      }
+      DecreaseAndDestroy();
+      block_ = other_block;
+    }
     ptr_ = other_ptr;
-    block_ = const_cast<IBaseControlBlock*>(other.block_);
-    ++block_->shared_count;
     return *this;
   }
  
   template <typename U = T>
-  SharedPtr& operator=(SharedPtr<U>&& other) {
-    auto other_ptr = static_cast<T*>(other.ptr_);
-    if (other_ptr == ptr_) {
-      if (other_ptr != nullptr) {
-        --block_->shared_count;
+  SharedPtr& operator=(SharedPtr<U, Policy>&& other) {
+    auto other_ptr = static_cast<element_type*>(other.ptr_);
+    auto other_block = other.block_;
+    other.ptr_ = nullptr;
+    other.block_ = nullptr;
+    if (other_block == block_) {
+      // Both references are ours now; one of them is redundant.
+      if (other_block != nullptr) {
+        other_block->DecreaseShared();
       }
-      other.ptr_ = nullptr;
-      other.block_ = nullptr;
-      return *this;
+    } else {
+      DecreaseAndDestroy();
+      block_ = other_block;
     }
- 
-    DecreaseAndDestroy();
- 
     ptr_ = other_ptr;
-    block_ = const_cast<IBaseControlBlock*>(other.block_);
-    other.ptr_ = nullptr;
-    other.block_ = nullptr;
     return *this;
   }
  
@@ -185,30 +1109,50 @@ class SharedPtr {
     if (block_ == nullptr) {
       throw std::runtime_error("use_count called on empty SharedPtr");
     }
-    return block_->shared_count;
+    return block_->SharedCount();
   }
  
-  T& operator*() noexcept {
+  T& operator*() noexcept
+    requires(!std::is_array_v<T>)
+  {
     return *ptr_;
   }
  
-  const T& operator*() const noexcept {
+  const T& operator*() const noexcept
+    requires(!std::is_array_v<T>)
+  {
     return *ptr_;
   }
  
-  T* operator->() noexcept {
+  T* operator->() noexcept
+    requires(!std::is_array_v<T>)
+  {
     return ptr_;
   }
  
-  const T* operator->() const noexcept {
+  const T* operator->() const noexcept
+    requires(!std::is_array_v<T>)
+  {
     return ptr_;
   }
  
-  T* get() noexcept {
+  element_type& operator[](std::ptrdiff_t index) noexcept
+    requires(std::is_array_v<T>)
+  {
+    return ptr_[index];
+  }
+ 
+  const element_type& operator[](std::ptrdiff_t index) const noexcept
+    requires(std::is_array_v<T>)
+  {
+    return ptr_[index];
+  }
+ 
+  element_type* get() noexcept {
     return ptr_;
   }
  
-  const T* get() const noexcept {
+  const element_type* get() const noexcept {
     return ptr_;
   }
  
@@ -218,23 +1162,64 @@ class SharedPtr {
   }
  
  private:
-  IBaseControlBlock* block_;
-  T* ptr_;
+  ControlBlock* block_;
+  element_type* ptr_;
  
-  // Make Shared constructor
-  SharedPtr(IBaseControlBlock* block, T* ptr) noexcept : block_(block), ptr_(ptr) {
+  // Adopts a shared reference already counted in block
+  SharedPtr(ControlBlock* block, element_type* ptr) noexcept : block_(block), ptr_(ptr) {
   }
  
-  void DecreaseAndDestroy() {
-    if (ptr_ == nullptr) {
-      return;
+  // Elements are value-initialized, or copied from init when it is given.
+  template <typename Alloc, typename... Init>
+  static SharedPtr AllocateArray(Alloc alloc, size_t count, const Init&... init) {
+    static_assert(sizeof...(Init) <= 1, "an array takes at most one initial value");
+    static_assert(!std::is_array_v<element_type>, "multidimensional arrays are not supported");
+    using Block = ArrayControlBlock<Alloc>;
+    using ElementTraits = std::allocator_traits<typename Block::ElementAlloc>;
+ 
+    typename Block::UnitAlloc unit_alloc(alloc);
+    size_t units = Block::Units(count);
+    auto block = reinterpret_cast<Block*>(std::to_address(Block::UnitTraits::allocate(unit_alloc, units)));
+    new (block) Block(alloc, count);
+ 
+    typename Block::ElementAlloc element_alloc(alloc);
+    element_type* elements = block->Elements();
+    size_t constructed = 0;
+    if constexpr (std::is_trivially_default_constructible_v<element_type> && sizeof...(Init) == 0 &&
+                  !requires { element_alloc.construct(elements); }) {
+      std::uninitialized_value_construct_n(elements, count);
+      constructed = count;
     }
+    try {
+      for (; constructed < count; ++constructed) {
+        ElementTraits::construct(element_alloc, elements + constructed, init...);
+      }
+    } catch (...) {
+      block->DestroyElements(constructed);
+      block->~Block();
+      Block::UnitTraits::deallocate(unit_alloc, reinterpret_cast<typename Block::Unit*>(block), units);
+      throw;
+    }
+    block->template Track<T>();
+    return SharedPtr(static_cast<ControlBlock*>(block), elements);
+  }
  
-    if (--block_->shared_count > 0) {
+  template <typename U>
+  void EnableSharedFromThisFor(U* ptr) {
+    if constexpr (std::is_base_of_v<EnableSharedFromThis<U, Policy>, U>) {
+      auto enable_shared_ptr = static_cast<EnableSharedFromThis<U, Policy>*>(ptr);
+      if (enable_shared_ptr->weak_this_.expired()) {
+        enable_shared_ptr->weak_this_ = WeakPtr<U, Policy>(block_, ptr);
+      }
+    }
+  }
+ 
+  void DecreaseAndDestroy() {
+    if (block_ == nullptr) {
       return;
     }
  
-    block_->SharedDestroy();
+    block_->DecreaseShared();
   }
  
  public:
@@ -242,63 +1227,155 @@ class SharedPtr {
     DecreaseAndDestroy();
   }
  
-  template <typename Type, typename Alloc, typename... Args>
-  friend SharedPtr<Type> allocateShared(Alloc alloc, Args&&... args);
+  template <typename Type, typename P, typename Alloc, typename... Args>
+  friend SharedPtr<Type, P> basicAllocateShared(Alloc alloc, Args&&... args);
  
-  template <class>
+  template <class, class>
   friend class SharedPtr;
  
-  template <class>
+  template <class, class>
   friend class WeakPtr;
  
-  template <class>
+  template <class, class>
   friend class EnableSharedFromThis;
+ 
+  template <class, class>
+  friend class AtomicSharedPtr;
+ 
+  friend struct PointerCastAccess;
+ 
+  template <class>
+  friend class SharedArena;
 };
  
+// allocateShared with an explicit reference-count policy. For T[] the
+// arguments are the element count and an optional initial value, for T[N]
+// just the optional initial value.
+template <typename T, typename Policy, typename Alloc, typename... Args>
+SharedPtr<T, Policy> basicAllocateShared(Alloc alloc, Args&&... args) {
+  if constexpr (std::is_unbounded_array_v<T>) {
+    return SharedPtr<T, Policy>::AllocateArray(alloc, args...);
+  } else if constexpr (std::is_bounded_array_v<T>) {
+    return SharedPtr<T, Policy>::AllocateArray(alloc, std::extent_v<T>, args...);
+  } else {
+    using MadeSharedCB = typename SharedPtr<T, Policy>::template MadeSharedControlBlock<T, Alloc>;
+    using MadeSharedCBAlloc = typename MadeSharedCB::MadeSharedCBAlloc;
+    using MadeSharedCBTraits = std::allocator_traits<MadeSharedCBAlloc>;
+ 
+    MadeSharedCBAlloc alloc2 = alloc;
+    MadeSharedCB* made_shared_cb_ptr = MadeSharedCBTraits::allocate(alloc2, 1);
+    new (made_shared_cb_ptr) MadeSharedCB(alloc);
+    T* t_ptr = reinterpret_cast<T*>(made_shared_cb_ptr->char_ptr);
+    try {
+      std::allocator_traits<Alloc>::construct(alloc, t_ptr, std::forward<Args>(args)...);
+    } catch (...) {
+      MadeSharedCBTraits::deallocate(alloc2, made_shared_cb_ptr, 1);
+      throw;
+    }
+ 
+    auto base_cb_ptr = static_cast<IBaseControlBlock<Policy>*>(made_shared_cb_ptr);
+    base_cb_ptr->template Track<T>();
+    SharedPtr<T, Policy> result(base_cb_ptr, t_ptr);
+    result.EnableSharedFromThisFor(t_ptr);
+    return result;
+  }
+}
+ 
+template <typename T, typename Policy, typename... Args>
+SharedPtr<T, Policy> basicMakeShared(Args&&... args) {
+  return basicAllocateShared<T, Policy>(std::allocator<std::remove_extent_t<T>>(), std::forward<Args>(args)...);
+}
+ 
 template <typename T, typename Alloc, typename... Args>
 SharedPtr<T> allocateShared(Alloc alloc, Args&&... args) {
-  using MadeSharedCB = typename SharedPtr<T>::template MadeSharedControlBlock<T, Alloc>;
-  using MadeSharedCBAlloc = typename MadeSharedCB::MadeSharedCBAlloc;
-  using MadeSharedCBTraits = std::allocator_traits<MadeSharedCBAlloc>;
+  return basicAllocateShared<T, AtomicRefCount>(alloc, std::forward<Args>(args)...);
+}
+ 
+template <typename T, typename... Args>
+SharedPtr<T> makeShared(Args&&... args) {
+  using Alloc = std::allocator<std::remove_extent_t<T>>;
+  return allocateShared<T, Alloc, Args...>(Alloc(), std::forward<Args>(args)...);
+}
  
-  MadeSharedCBAlloc alloc2 = alloc;
-  MadeSharedCB* made_shared_cb_ptr = MadeSharedCBTraits::allocate(alloc2, 1);
-  new (made_shared_cb_ptr) MadeSharedCB(1, 0, alloc);
-  T* t_ptr = reinterpret_cast<T*>(made_shared_cb_ptr->char_ptr);
-  std::allocator_traits<Alloc>::construct(alloc, t_ptr, std::forward<Args>(args)...);
+// Reaches the stored pointer of a const SharedPtr, which get() only exposes
+// as a pointer to const.
+struct PointerCastAccess {
+  template <typename T, typename Policy>
+  static typename SharedPtr<T, Policy>::element_type* Get(const SharedPtr<T, Policy>& ptr) noexcept {
+    return ptr.ptr_;
+  }
+};
  
-  auto base_cb_ptr = static_cast<IBaseControlBlock*>(made_shared_cb_ptr);
+// The casts share the control block of ptr; none of them allocates.
+template <typename T, typename U, typename Policy>
+SharedPtr<T, Policy> staticPointerCast(const SharedPtr<U, Policy>& ptr) noexcept {
+  using Element = typename SharedPtr<T, Policy>::element_type;
+  return SharedPtr<T, Policy>(ptr, static_cast<Element*>(PointerCastAccess::Get(ptr)));
+}
  
-  if constexpr (std::is_base_of_v<EnableSharedFromThis<T>, T>) {
-    auto enable_shared_ptr = static_cast<EnableSharedFromThis<T>*>(t_ptr);
-    enable_shared_ptr->ptr_ = t_ptr;
-    enable_shared_ptr->block_ = made_shared_cb_ptr;
+template <typename T, typename U, typename Policy>
+SharedPtr<T, Policy> staticPointerCast(SharedPtr<U, Policy>&& ptr) noexcept {
+  using Element = typename SharedPtr<T, Policy>::element_type;
+  return SharedPtr<T, Policy>(std::move(ptr), static_cast<Element*>(PointerCastAccess::Get(ptr)));
+}
+ 
+// Returns an empty pointer and leaves ptr alone when the cast fails.
+template <typename T, typename U, typename Policy>
+SharedPtr<T, Policy> dynamicPointerCast(const SharedPtr<U, Policy>& ptr) noexcept {
+  using Element = typename SharedPtr<T, Policy>::element_type;
+  if (auto cast = dynamic_cast<Element*>(PointerCastAccess::Get(ptr))) {
+    return SharedPtr<T, Policy>(ptr, cast);
   }
+  return SharedPtr<T, Policy>();
+}
  
-  return SharedPtr(base_cb_ptr, t_ptr);
+template <typename T, typename U, typename Policy>
+SharedPtr<T, Policy> dynamicPointerCast(SharedPtr<U, Policy>&& ptr) noexcept {
+  using Element = typename SharedPtr<T, Policy>::element_type;
+  if (auto cast = dynamic_cast<Element*>(PointerCastAccess::Get(ptr))) {
+    return SharedPtr<T, Policy>(std::move(ptr), cast);
+  }
+  return SharedPtr<T, Policy>();
 }
  
-template <typename T, typename... Args>
-SharedPtr<T> makeShared(Args&&... args) {
-  return allocateShared<T, std::allocator<T>, Args...>(std::allocator<T>(), std::forward<Args>(args)...);
+template <typename T, typename U, typename Policy>
+SharedPtr<T, Policy> constPointerCast(const SharedPtr<U, Policy>& ptr) noexcept {
+  using Element = typename SharedPtr<T, Policy>::element_type;
+  return SharedPtr<T, Policy>(ptr, const_cast<Element*>(PointerCastAccess::Get(ptr)));
 }
  
-template <typename T>
+template <typename T, typename U, typename Policy>
+SharedPtr<T, Policy> constPointerCast(SharedPtr<U, Policy>&& ptr) noexcept {
+  using Element = typename SharedPtr<T, Policy>::element_type;
+  return SharedPtr<T, Policy>(std::move(ptr), const_cast<Element*>(PointerCastAccess::Get(ptr)));
+}
+ 
+template <typename T, typename U, typename Policy>
+SharedPtr<T, Policy> reinterpretPointerCast(const SharedPtr<U, Policy>& ptr) noexcept {
+  using Element = typename SharedPtr<T, Policy>::element_type;
+  return SharedPtr<T, Policy>(ptr, reinterpret_cast<Element*>(PointerCastAccess::Get(ptr)));
+}
+ 
+template <typename T, typename U, typename Policy>
+SharedPtr<T, Policy> reinterpretPointerCast(SharedPtr<U, Policy>&& ptr) noexcept {
+  using Element = typename SharedPtr<T, Policy>::element_type;
+  return SharedPtr<T, Policy>(std::move(ptr), reinterpret_cast<Element*>(PointerCastAccess::Get(ptr)));
+}
+ 
+template <typename T, typename Policy>
 class WeakPtr {
  public:
+  using element_type = std::remove_extent_t<T>;
+ 
   WeakPtr() : ptr_(nullptr), block_(nullptr) {
   }
  
   template <typename U = T>
-  WeakPtr(const SharedPtr<U>& shared_ptr)
-      : ptr_(static_cast<T*>(shared_ptr.ptr_)), block_(reinterpret_cast<decltype(block_)>(shared_ptr.block_)) {
-    ++block_->weak_count;
+    requires std::is_convertible_v<typename SharedPtr<U, Policy>::element_type*, element_type*>
+  WeakPtr(const SharedPtr<U, Policy>& shared_ptr) : WeakPtr(shared_ptr.block_, static_cast<element_type*>(shared_ptr.ptr_)) {
   }
  
-  WeakPtr(const WeakPtr& other) : ptr_(other.ptr_), block_(other.block_) {
-    if (block_ != nullptr) {
-      ++block_->weak_count;
-    }
+  WeakPtr(const WeakPtr& other) : WeakPtr(other.block_, other.ptr_) {
   }
  
   WeakPtr(WeakPtr&& other) noexcept : ptr_(other.ptr_), block_(other.block_) {
@@ -311,75 +1388,70 @@ class WeakPtr {
   }
  
   WeakPtr& operator=(WeakPtr&& other) noexcept {
-    return this->operator= <T>(std::forward<WeakPtr<T>>(other));
+    return this->operator= <T>(std::move(other));
   }
  
   template <typename U = T>
-  WeakPtr(const WeakPtr<U>& weak_ptr)
-      : ptr_(static_cast<T*>(weak_ptr.ptr_)), block_(reinterpret_cast<decltype(block_)>(weak_ptr.block_)) {
-    ++block_->weak_count;
+    requires std::is_convertible_v<typename WeakPtr<U, Policy>::element_type*, element_type*>
+  WeakPtr(const WeakPtr<U, Policy>& weak_ptr) : WeakPtr(weak_ptr.block_, static_cast<element_type*>(weak_ptr.ptr_)) {
   }
  
   template <typename U = T>
-  WeakPtr(WeakPtr<U>&& weak_ptr)
-      : ptr_(static_cast<T*>(weak_ptr.ptr_)), block_(reinterpret_cast<decltype(block_)>(weak_ptr.block_)) {
+    requires std::is_convertible_v<typename WeakPtr<U, Policy>::element_type*, element_type*>
+  WeakPtr(WeakPtr<U, Policy>&& weak_ptr) : ptr_(static_cast<element_type*>(weak_ptr.ptr_)), block_(weak_ptr.block_) {
     weak_ptr.ptr_ = nullptr;
     weak_ptr.block_ = nullptr;
   }
  
   template <typename U = T>
-  WeakPtr& operator=(const WeakPtr<U>& other) {
-    auto other_ptr = static_cast<T*>(other.ptr_);
-    if (other_ptr == ptr_) {
-      return *this;
+  WeakPtr& operator=(const WeakPtr<U, Policy>& other) {
+    auto other_ptr = static_cast<element_type*>(other.ptr_);
+    auto other_block = other.block_;
+    if (other_block != block_) {
+      if (other_block != nullptr) {
+        other_block->AddWeak();
+      }
+      DecreaseAndDestroy();
+      block_ = other_block;
     }
- 
-    DecreaseAndDestroy();
- 
     ptr_ = other_ptr;
-    block_ = reinterpret_cast<decltype(block_)>(other.block_);
-    ++block_->weak_count;
     return *this;
   }
  
   template <typename U = T>
-  WeakPtr& operator=(WeakPtr<U>&& other) {
-    auto other_ptr = static_cast<T*>(other.ptr_);
-    if (other_ptr == ptr_) {
-      if (other.ptr_ != nullptr) {
-        --block_->weak_count;
+  WeakPtr& operator=(WeakPtr<U, Policy>&& other) {
+    auto other_ptr = static_cast<element_type*>(other.ptr_);
+    auto other_block = other.block_;
+    other.ptr_ = nullptr;
+    other.block_ = nullptr;
+    if (other_block == block_) {
+      if (other_block != nullptr) {
+        other_block->DecreaseWeak();
       }
-      other.ptr_ = nullptr;
-      other.block_ = nullptr;
-      return *this;
+    } else {
+      DecreaseAndDestroy();
+      block_ = other_block;
     }
- 
-    DecreaseAndDestroy();
- 
     ptr_ = other_ptr;
-    block_ = reinterpret_cast<decltype(block_)>(other.block_);
-    other.ptr_ = nullptr;
-    other.block_ = nullptr;
     return *this;
   }
  
   bool expired() const {
-    return block_ == nullptr || block_->shared_count == 0;
+    return block_ == nullptr || block_->SharedCount() == 0;
   }
  
-  SharedPtr<T> lock() const {
-    if (expired()) {
+  SharedPtr<T, Policy> lock() const {
+    if (block_ == nullptr || !block_->TryIncreaseShared()) {
       throw std::bad_weak_ptr();
     }
-    ++block_->shared_count;
-    return SharedPtr<T>(block_, ptr_);
+    return SharedPtr<T, Policy>(block_, ptr_);
   }
  
   size_t use_count() const {
     if (block_ == nullptr) {
       throw std::runtime_error("use_count called on empty SharedPtr");
     }
-    return block_->shared_count;
+    return block_->SharedCount();
   }
  
   ~WeakPtr() {
@@ -387,44 +1459,240 @@ class WeakPtr {
   }
  
  private:
-  T* ptr_;
-  IBaseControlBlock* block_;
+  element_type* ptr_;
+  IBaseControlBlock<Policy>* block_;
+ 
+  WeakPtr(IBaseControlBlock<Policy>* block, element_type* ptr) : ptr_(ptr), block_(block) {
+    if (block_ != nullptr) {
+      block_->AddWeak();
+    }
+  }
  
   void DecreaseAndDestroy() {
-    if (ptr_ == nullptr) {
+    if (block_ == nullptr) {
       return;
     }
  
-    if (--block_->weak_count == 0 && block_->shared_count == 0) {
-      block_->WeakDestroy();
-    }
+    block_->DecreaseWeak();
   }
  
-  template <class>
+  template <class, class>
+  friend class SharedPtr;
+ 
+  template <class, class>
   friend class WeakPtr;
+ 
+  template <class, class>
+  friend class EnableSharedFromThis;
 };
  
-template <typename T>
+template <typename T, typename Policy>
 class EnableSharedFromThis {
  public:
-  EnableSharedFromThis() : ptr_(nullptr), block_(nullptr) {
+  EnableSharedFromThis() = default;
+ 
+  // A copy is not owned by the SharedPtr that owns the original.
+  EnableSharedFromThis(const EnableSharedFromThis&) noexcept {
   }
  
-  SharedPtr<T> shared_from_this() {
-    if (block_ == nullptr) {
+  EnableSharedFromThis& operator=(const EnableSharedFromThis&) noexcept {
+    return *this;
+  }
+ 
+  SharedPtr<T, Policy> shared_from_this() {
+    if (weak_this_.block_ == nullptr) {
       throw std::runtime_error("No SharedPtr asigned to this object");
     }
  
-    ++block_->shared_count;
-    return SharedPtr<T>(block_, ptr_);
+    return weak_this_.lock();
   }
  
  private:
-  T* ptr_;
-  typename SharedPtr<T>::IBaseControlBlock* block_;
+  WeakPtr<T, Policy> weak_this_;
  
-  template <class>
+  template <class, class>
   friend class SharedPtr;
 };
  
+// Split reference count: the atomic word packs a pointer to an immutable
+// holder of the published SharedPtr in its low 48 bits and the number of
+// readers currently copying out of that holder in its high 16 bits. A reader
+// pins the holder with one fetch_add on the word, copies the SharedPtr and
+// unpins with a CAS. A writer that swaps the holder out moves the pinned
+// count over to the holder's own count, so readers never wait for writers.
+// At most 65535 readers may be inside load() at once.
+template <typename T, typename Policy>
+class AtomicSharedPtr {
+  static_assert(!std::is_base_of_v<SingleThreadRefCount, Policy>, "AtomicSharedPtr needs thread-safe counts");
+  static_assert(sizeof(void*) == 8, "AtomicSharedPtr packs 48-bit pointers");
+ 
+ public:
+  AtomicSharedPtr() noexcept : word_(0), version_(0) {
+  }
+ 
+  AtomicSharedPtr(SharedPtr<T, Policy> desired) : word_(Pack(MakeHolder(std::move(desired)))), version_(0) {
+  }
+ 
+  AtomicSharedPtr(const AtomicSharedPtr&) = delete;
+ 
+  AtomicSharedPtr& operator=(const AtomicSharedPtr&) = delete;
+ 
+  ~AtomicSharedPtr() {
+    Unref(Unpack(word_.load(std::memory_order_acquire)));
+  }
+ 
+  SharedPtr<T, Policy> load() const {
+    Holder* holder = Pin();
+    SharedPtr<T, Policy> result = holder != nullptr ? holder->value : SharedPtr<T, Policy>();
+    Unpin(holder);
+    return result;
+  }
+ 
+  void store(SharedPtr<T, Policy> desired) {
+    exchange(std::move(desired));
+  }
+ 
+  SharedPtr<T, Policy> exchange(SharedPtr<T, Policy> desired) {
+    Holder* holder = MakeHolder(std::move(desired));
+    std::uint64_t old = word_.exchange(Pack(holder), std::memory_order_acq_rel);
+    version_.fetch_add(1, std::memory_order_release);
+ 
+    Holder* old_holder = Unpack(old);
+    SharedPtr<T, Policy> result = old_holder != nullptr ? old_holder->value : SharedPtr<T, Policy>();
+    if (old_holder != nullptr) {
+      old_holder->refs.fetch_add(PinCount(old), std::memory_order_relaxed);
+      Unref(old_holder);
+    }
+    return result;
+  }
+ 
+  // Compares the stored control block and pointer with those of expected.
+  bool compare_exchange_strong(SharedPtr<T, Policy>& expected, SharedPtr<T, Policy> desired) {
+    Holder* replacement = nullptr;
+    while (true) {
+      Holder* holder = Pin();
+      if (!Holds(holder, expected)) {
+        expected = holder != nullptr ? holder->value : SharedPtr<T, Policy>();
+        Unpin(holder);
+        Unref(replacement);
+        return false;
+      }
+      if (replacement == nullptr && desired.block_ != nullptr) {
+        replacement = MakeHolder(std::move(desired));
+      }
+ 
+      std::uint64_t word = word_.load(std::memory_order_relaxed);
+      while (Unpack(word) == holder) {
+        if (word_.compare_exchange_weak(word, Pack(replacement), std::memory_order_acq_rel,
+                                        std::memory_order_relaxed)) {
+          version_.fetch_add(1, std::memory_order_release);
+          if (holder != nullptr) {
+            // Our own pin is among the moved ones and is dropped with the rest.
+            holder->refs.fetch_add(PinCount(word), std::memory_order_relaxed);
+            Unref(holder);
+            Unref(holder);
+          }
+          return true;
+        }
+      }
+      Unpin(holder);
+    }
+  }
+ 
+  bool compare_exchange_weak(SharedPtr<T, Policy>& expected, SharedPtr<T, Policy> desired) {
+    return compare_exchange_strong(expected, std::move(desired));
+  }
+ 
+  // Bumped after every successful store; see CachedReader.
+  std::uint64_t version() const noexcept {
+    return version_.load(std::memory_order_acquire);
+  }
+ 
+ private:
+  struct Holder {
+    SharedPtr<T, Policy> value;
+    std::atomic<std::uint64_t> refs = 1;
+  };
+ 
+  static constexpr int kPinShift = 48;
+  static constexpr std::uint64_t kPin = std::uint64_t(1) << kPinShift;
+  static constexpr std::uint64_t kPointerMask = kPin - 1;
+ 
+  // Readers hammer word_; keep the version, which they only read, elsewhere.
+  alignas(64) mutable std::atomic<std::uint64_t> word_;
+  alignas(64) std::atomic<std::uint64_t> version_;
+ 
+  static Holder* MakeHolder(SharedPtr<T, Policy>&& value) {
+    if (value.block_ == nullptr) {
+      return nullptr;
+    }
+    return new Holder{std::move(value)};
+  }
+ 
+  static std::uint64_t Pack(Holder* holder) noexcept {
+    return reinterpret_cast<std::uintptr_t>(holder);
+  }
+ 
+  static Holder* Unpack(std::uint64_t word) noexcept {
+    return reinterpret_cast<Holder*>(word & kPointerMask);
+  }
+ 
+  static std::uint64_t PinCount(std::uint64_t word) noexcept {
+    return word >> kPinShift;
+  }
+ 
+  static bool Holds(Holder* holder, const SharedPtr<T, Policy>& expected) noexcept {
+    if (holder == nullptr) {
+      return expected.block_ == nullptr;
+    }
+    return holder->value.block_ == expected.block_ && holder->value.ptr_ == expected.ptr_;
+  }
+ 
+  static void Unref(Holder* holder) {
+    if (holder != nullptr && holder->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete holder;
+    }
+  }
+ 
+  Holder* Pin() const noexcept {
+    return Unpack(word_.fetch_add(kPin, std::memory_order_acq_rel));
+  }
+ 
+  // If the holder was swapped out meanwhile, the pin was moved to its count.
+  void Unpin(Holder* holder) const {
+    std::uint64_t word = word_.load(std::memory_order_relaxed);
+    while (Unpack(word) == holder) {
+      if (word_.compare_exchange_weak(word, word - kPin, std::memory_order_release, std::memory_order_relaxed)) {
+        return;
+      }
+    }
+    Unref(holder);
+  }
+};
+ 
+// Per-thread view of an AtomicSharedPtr. get() touches only the shared
+// version counter, which stays in every reader's cache until a writer
+// publishes, and reloads the pointer only then.
+template <typename T, typename Policy = AtomicRefCount>
+class CachedReader {
+ public:
+  explicit CachedReader(const AtomicSharedPtr<T, Policy>& source)
+      : source_(&source), version_(source.version()), cached_(source.load()) {
+  }
+ 
+  const SharedPtr<T, Policy>& get() {
+    std::uint64_t version = source_->version();
+    if (version != version_) {
+      cached_ = source_->load();
+      version_ = version;
+    }
+    return cached_;
+  }
+ 
+ private:
+  const AtomicSharedPtr<T, Policy>* source_;
+  std::uint64_t version_;
+  SharedPtr<T, Policy> cached_;
+};
+ 
 #endif  // SHAREDPTR_H
@@ -0,0 +1,132 @@
+// g++ -std=c++20 -g -fsanitize=thread -pthread -I. tests/atomic_ref_count_test.cpp && ./a.out
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "shared_ptr.h"
+#include "tests/check.h"
+#include "tests/test_util.h"
+
+std::atomic<int> constructed = 0;
+std::atomic<int> destroyed = 0;
+
+struct Counted {
+    int value;
+    int checksum;
+
+    explicit Counted(int value) : value(value), checksum(~value) {
+        constructed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Counted() {
+        CHECK(checksum == ~value);
+        checksum = 0;
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+// Threads copy and drop shared references to the same objects; each object
+// is destroyed once, after its last reference is gone.
+void TestCopyAndRelease() {
+    constexpr int kObjects = 500;
+    constexpr int kThreads = 4;
+    constructed = 0;
+    destroyed = 0;
+    std::vector<SharedPtr<Counted>> objects;
+    for (int i = 0; i < kObjects; ++i) {
+        objects.push_back(i % 2 == 0 ? makeShared<Counted>(i) : SharedPtr<Counted>(new Counted(i)));
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([copies = objects]() mutable {
+            for (int round = 0; round < 10; ++round) {
+                for (auto& copy : copies) {
+                    SharedPtr<Counted> again = copy;
+                    CHECK(again->checksum == ~again->value);
+                    CHECK(again.use_count() >= 2);
+                }
+            }
+            for (auto& copy : copies) {
+                copy.reset();
+            }
+        });
+    }
+    objects.clear();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CHECK(constructed == kObjects);
+    CHECK(destroyed == kObjects);
+}
+
+// Readers lock weak references while the last strong one is dropped; a
+// successful lock always sees a live object, and once lock() has failed it
+// keeps failing.
+void TestLockRacesLastRelease() {
+    constexpr int kRounds = 300;
+    constexpr int kReaders = 3;
+    constructed = 0;
+    destroyed = 0;
+    for (int round = 0; round < kRounds; ++round) {
+        SharedPtr<Counted> owned = round % 2 == 0 ? makeShared<Counted>(round) : SharedPtr<Counted>(new Counted(round));
+        WeakPtr<Counted> weak = owned;
+        std::vector<std::thread> readers;
+        for (int r = 0; r < kReaders; ++r) {
+            readers.emplace_back([weak, round] {
+                bool failed = false;
+                for (int i = 0; i < 200; ++i) {
+                    SharedPtr<Counted> locked = TryLock(weak);
+                    if (locked.get() == nullptr) {
+                        failed = true;
+                        CHECK(weak.expired());
+                    }
+                    else {
+                        CHECK(!failed);
+                        CHECK(locked->value == round && locked->checksum == ~round);
+                    }
+                }
+            });
+        }
+        owned.reset();
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        CHECK(weak.expired());
+        CHECK(destroyed == round + 1);
+    }
+}
+
+// Weak references are dropped on other threads than the strong ones; the
+// block outlives the object until the last of them is gone.
+void TestWeakOutlivesObject() {
+    constexpr int kObjects = 200;
+    destroyed = 0;
+    std::vector<SharedPtr<Counted>> strong;
+    std::vector<WeakPtr<Counted>> weak;
+    for (int i = 0; i < kObjects; ++i) {
+        strong.push_back(makeShared<Counted>(i));
+        weak.emplace_back(strong.back());
+    }
+    std::thread drop_strong([strong = std::move(strong)]() mutable { strong.clear(); });
+    std::thread drop_weak([weak]() mutable {
+        for (auto& ptr : weak) {
+            TryLock(ptr);
+        }
+        weak.clear();
+    });
+    drop_strong.join();
+    drop_weak.join();
+    CHECK(destroyed == kObjects);
+    for (auto& ptr : weak) {
+        CHECK(ptr.expired());
+    }
+}
+
+int main() {
+    TestCopyAndRelease();
+    TestLockRacesLastRelease();
+    TestWeakOutlivesObject();
+    return 0;
+}
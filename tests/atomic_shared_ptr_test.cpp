@@ -0,0 +1,182 @@
+// g++ -std=c++20 -g -fsanitize=thread -pthread -I. tests/atomic_shared_ptr_test.cpp && ./a.out
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "shared_ptr.h"
+#include "tests/check.h"
+
+std::atomic<int> live = 0;
+
+// Published whole; a reader that sees a torn or freed one fails the check.
+struct Config {
+    int generation;
+    int doubled;
+
+    explicit Config(int generation) : generation(generation), doubled(2 * generation) {
+        live.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~Config() {
+        CHECK(doubled == 2 * generation);
+        doubled = -1;
+        live.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
+
+// Writers publish increasing generations while readers load, both directly
+// and through a CachedReader; nobody sees a generation go backwards.
+void TestPublishAndRead() {
+    constexpr int kWriters = 2;
+    constexpr int kReaders = 3;
+    constexpr int kStores = 2000;
+    {
+        AtomicSharedPtr<Config> config(makeShared<Config>(0));
+        std::atomic<int> next = 1;
+        std::atomic<int> writing = kWriters;
+        std::vector<std::thread> threads;
+        for (int w = 0; w < kWriters; ++w) {
+            threads.emplace_back([&] {
+                for (int i = 0; i < kStores; ++i) {
+                    // Generations are published in order: a writer only
+                    // replaces the one it has seen.
+                    SharedPtr<Config> expected = config.load();
+                    auto desired = makeShared<Config>(next.fetch_add(1, std::memory_order_relaxed));
+                    while (expected->generation < desired->generation &&
+                           !config.compare_exchange_strong(expected, desired)) {
+                    }
+                }
+                writing.fetch_sub(1, std::memory_order_release);
+            });
+        }
+        for (int r = 0; r < kReaders; ++r) {
+            threads.emplace_back([&, r] {
+                CachedReader<Config> cached(config);
+                int seen = 0;
+                while (writing.load(std::memory_order_acquire) > 0) {
+                    SharedPtr<Config> loaded = r == 0 ? config.load() : cached.get();
+                    CHECK(loaded->doubled == 2 * loaded->generation);
+                    CHECK(loaded->generation >= seen);
+                    seen = loaded->generation;
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        CHECK(config.load()->generation > 0);
+    }
+    CHECK(live == 0);
+}
+
+// exchange() hands every published value back exactly once, however many
+// threads swap at the same time.
+void TestExchange() {
+    constexpr int kThreads = 4;
+    constexpr int kSwaps = 1000;
+    {
+        AtomicSharedPtr<Config> slot(makeShared<Config>(0));
+        std::atomic<long> returned = 0;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&, t] {
+                for (int i = 1; i <= kSwaps; ++i) {
+                    SharedPtr<Config> old = slot.exchange(makeShared<Config>(t * kSwaps + i));
+                    returned.fetch_add(old->generation, std::memory_order_relaxed);
+                    slot.load();
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        long total = static_cast<long>(kThreads * kSwaps) * (kThreads * kSwaps + 1) / 2;
+        CHECK(returned + slot.load()->generation == total);
+        slot.store(SharedPtr<Config>());
+        CHECK(slot.load().get() == nullptr);
+    }
+    CHECK(live == 0);
+}
+
+// compare_exchange_strong as a counter: no increment is lost.
+void TestCompareExchangeCounter() {
+    constexpr int kThreads = 4;
+    constexpr int kIncrements = 500;
+    {
+        AtomicSharedPtr<Config> counter(makeShared<Config>(0));
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&] {
+                for (int i = 0; i < kIncrements; ++i) {
+                    SharedPtr<Config> expected = counter.load();
+                    while (!counter.compare_exchange_strong(expected, makeShared<Config>(expected->generation + 1))) {
+                    }
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        CHECK(counter.load()->generation == kThreads * kIncrements);
+    }
+    CHECK(live == 0);
+}
+
+// A CachedReader hands back its cached pointer until a store succeeds, and
+// keeps the value it caches alive in the meantime. Once a store has
+// returned, every reader that syncs with it sees the new value.
+void TestCachedReader() {
+    {
+        AtomicSharedPtr<Config> config(makeShared<Config>(1));
+        CachedReader<Config> cached(config);
+        const SharedPtr<Config>& first = cached.get();
+        CHECK(first->generation == 1 && first.use_count() == 2);
+        CHECK(&cached.get() == &first && first.use_count() == 2);
+
+        SharedPtr<Config> expected = makeShared<Config>(7);
+        CHECK(!config.compare_exchange_strong(expected, makeShared<Config>(2)));
+        CHECK(expected.get() == first.get() && cached.get()->generation == 1);
+        expected.reset();
+
+        config.store(makeShared<Config>(2));
+        CHECK(live == 2);
+        CHECK(cached.get()->generation == 2 && live == 1);
+        expected = config.load();
+        CHECK(config.compare_exchange_strong(expected, makeShared<Config>(3)));
+        CHECK(cached.get()->generation == 3);
+        expected.reset();
+        config.exchange(SharedPtr<Config>());
+        CHECK(cached.get().get() == nullptr && live == 0);
+    }
+    CHECK(live == 0);
+
+    // Lock step: the writer waits for the reader to check each value.
+    AtomicSharedPtr<Config> config(makeShared<Config>(0));
+    std::atomic<int> stored = 0;
+    std::atomic<int> checked = 0;
+    std::thread reader([&] {
+        CachedReader<Config> cached(config);
+        for (int generation = 1; generation <= 100; ++generation) {
+            while (stored.load(std::memory_order_acquire) < generation) {
+            }
+            CHECK(cached.get()->generation == generation);
+            checked.store(generation, std::memory_order_release);
+        }
+    });
+    for (int generation = 1; generation <= 100; ++generation) {
+        config.store(makeShared<Config>(generation));
+        stored.store(generation, std::memory_order_release);
+        while (checked.load(std::memory_order_acquire) < generation) {
+        }
+    }
+    reader.join();
+}
+
+int main() {
+    TestPublishAndRead();
+    TestExchange();
+    TestCompareExchangeCounter();
+    TestCachedReader();
+    return 0;
+}
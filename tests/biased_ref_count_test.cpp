@@ -0,0 +1,144 @@
+// g++ -std=c++20 -g -fsanitize=thread -pthread -I. tests/biased_ref_count_test.cpp && ./a.out
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "shared_ptr.h"
+#include "tests/check.h"
+#include "tests/test_util.h"
+
+using Ptr = SharedPtr<int, BiasedRefCount>;
+using Weak = WeakPtr<int, BiasedRefCount>;
+
+std::atomic<int> destroyed = 0;
+
+struct Counted {
+    int value;
+
+    explicit Counted(int value) : value(value) {
+    }
+
+    ~Counted() {
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+// The owner drops its reference first and another thread drops the last
+// one, so the block waits in the owner's queue with no reference left. It
+// must look dead to every thread until the owner merges it.
+void TestQueuedBlockStaysDead() {
+    destroyed = 0;
+    auto owned = basicMakeShared<Counted, BiasedRefCount>(1);
+    SharedPtr<Counted, BiasedRefCount> moved = owned;
+    WeakPtr<Counted, BiasedRefCount> weak = owned;
+    owned.reset();
+    std::thread([moved = std::move(moved)]() mutable { moved.reset(); }).join();
+    CHECK(destroyed == 0);
+
+    std::thread([weak] {
+        CHECK(weak.expired());
+        CHECK(TryLock(weak).get() == nullptr);
+    }).join();
+    CHECK(weak.expired());
+    CHECK(TryLock(weak).get() == nullptr);
+
+    BiasedRefCount::MergePending();
+    CHECK(destroyed == 1);
+    CHECK(weak.expired());
+}
+
+// While the owner still holds a reference, a block queued by another
+// thread's release is alive and can be locked from anywhere.
+void TestQueuedBlockWithOwnerReference() {
+    Ptr owned = basicMakeShared<int, BiasedRefCount>(2);
+    Ptr moved = owned;
+    Weak weak = owned;
+    std::thread([moved = std::move(moved)]() mutable { moved.reset(); }).join();
+    std::thread([weak] {
+        CHECK(!weak.expired());
+        Ptr locked = TryLock(weak);
+        CHECK(locked.get() != nullptr && *locked == 2);
+    }).join();
+    CHECK(TryLock(weak).get() != nullptr);
+    CHECK(owned.use_count() == 1);
+}
+
+// Readers lock while each of them drops the reference the owner gave it;
+// once a reader has seen the block expire, no later lock() may succeed,
+// though the block stays queued until the owner merges it.
+void TestExpiredThenLock() {
+    constexpr int kRounds = 200;
+    constexpr int kReaders = 3;
+    destroyed = 0;
+    for (int round = 0; round < kRounds; ++round) {
+        auto owned = basicMakeShared<Counted, BiasedRefCount>(round);
+        WeakPtr<Counted, BiasedRefCount> weak = owned;
+        std::vector<SharedPtr<Counted, BiasedRefCount>> copies(kReaders, owned);
+        owned.reset();
+        std::atomic<bool> seen_expired = false;
+        std::vector<std::thread> readers;
+        for (int r = 0; r < kReaders; ++r) {
+            readers.emplace_back([weak, copy = std::move(copies[r]), &seen_expired, round, r]() mutable {
+                for (int i = 0; i < 100; ++i) {
+                    if (i == r * 20) {
+                        copy.reset();
+                    }
+                    bool expired = seen_expired.load(std::memory_order_acquire) || weak.expired();
+                    auto locked = TryLock(weak);
+                    if (expired) {
+                        seen_expired.store(true, std::memory_order_release);
+                        CHECK(locked.get() == nullptr);
+                    }
+                    else if (locked.get() != nullptr) {
+                        CHECK(locked->value == round);
+                    }
+                }
+            });
+        }
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        CHECK(seen_expired);
+        CHECK(destroyed == round);
+        BiasedRefCount::MergePending();
+        CHECK(weak.expired());
+        CHECK(destroyed == round + 1);
+    }
+}
+
+// Copies made on one thread and dropped on many; every object is destroyed
+// exactly once.
+void TestCrossThreadRelease() {
+    constexpr int kObjects = 1000;
+    constexpr int kThreads = 4;
+    destroyed = 0;
+    std::vector<SharedPtr<Counted, BiasedRefCount>> objects;
+    for (int i = 0; i < kObjects; ++i) {
+        objects.push_back(basicMakeShared<Counted, BiasedRefCount>(i));
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([copies = objects]() mutable {
+            for (auto& copy : copies) {
+                auto again = copy;
+                copy.reset();
+            }
+        });
+    }
+    objects.clear();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    BiasedRefCount::MergePending();
+    CHECK(destroyed == kObjects);
+}
+
+int main() {
+    TestQueuedBlockStaysDead();
+    TestQueuedBlockWithOwnerReference();
+    TestExpiredThenLock();
+    TestCrossThreadRelease();
+    return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+#include <cstdio>
+#include <cstdlib>
+
+// Stays active under -DNDEBUG, unlike assert.
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::abort();                                                             \
+        }                                                                             \
+    } while (false)
+
+#endif  // TESTS_CHECK_H
@@ -0,0 +1,85 @@
+// g++ -std=c++20 -g -fsanitize=thread -pthread -I. tests/concurrent_stack_storage_test.cpp && ./a.out
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "StackAllocator.h"
+#include "tests/check.h"
+
+constexpr std::size_t kArena = 1 << 20;
+
+bool Aligned(void* ptr, std::size_t alignment) {
+    return reinterpret_cast<std::uintptr_t>(ptr) % alignment == 0;
+}
+
+void TestAlignment(std::size_t chunk_size) {
+    auto arena = std::make_unique<ConcurrentStackStorage<kArena>>(chunk_size);
+    auto& storage = *arena;
+    for (std::size_t alignment : { 1, 8, 16, 64, 256, 4096 }) {
+        for (std::size_t size : { 1, 16, 24, 100 }) {
+            void* ptr = storage.allocate_raw(alignment, size);
+            CHECK(ptr != nullptr);
+            CHECK(Aligned(ptr, alignment));
+            CHECK(storage.owns(ptr));
+        }
+    }
+}
+
+// Every thread fills its blocks with its own id; overlapping blocks would
+// show up as foreign bytes.
+void TestDisjoint(std::size_t chunk_size) {
+    auto arena = std::make_unique<ConcurrentStackStorage<kArena>>(chunk_size);
+    auto& storage = *arena;
+    constexpr int kThreads = 4;
+    constexpr int kBlocks = 1000;
+    std::vector<std::vector<std::pair<unsigned char*, std::size_t>>> blocks(kThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kBlocks; ++i) {
+                std::size_t size = 1 + (i * 7 + t) % 40;
+                std::size_t alignment = std::size_t(1) << (i % 7);
+                auto* ptr = static_cast<unsigned char*>(storage.allocate_raw(alignment, size));
+                if (ptr == nullptr) {
+                    break;
+                }
+                CHECK(Aligned(ptr, alignment));
+                std::fill(ptr, ptr + size, static_cast<unsigned char>(t + 1));
+                blocks[t].emplace_back(ptr, size);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (int t = 0; t < kThreads; ++t) {
+        for (auto [ptr, size] : blocks[t]) {
+            for (std::size_t i = 0; i < size; ++i) {
+                CHECK(ptr[i] == t + 1);
+            }
+        }
+    }
+}
+
+void TestExhaustion() {
+    ConcurrentStackStorage<4096> storage(256);
+    std::size_t total = 0;
+    while (storage.allocate_raw(8, 24) != nullptr) {
+        total += 24;
+    }
+    CHECK(total > 0 && total <= 4096);
+    storage.reset();
+    CHECK(storage.allocate_raw(8, 24) != nullptr);
+}
+
+int main() {
+    TestAlignment(0);
+    TestAlignment(512);
+    TestDisjoint(0);
+    TestDisjoint(256);
+    TestExhaustion();
+    return 0;
+}
@@ -0,0 +1,171 @@
+// g++ -std=c++20 -g -fsanitize=thread -pthread -I. tests/control_block_pool_test.cpp && ./a.out
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "shared_ptr.h"
+#include "tests/check.h"
+
+using Pool = ControlBlockPool<40, 16>;
+
+// Slabs are the only over-aligned allocations here; counting them shows
+// when pools free their memory.
+std::atomic<int> live_slabs = 0;
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    live_slabs.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = std::aligned_alloc(static_cast<std::size_t>(align), size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    live_slabs.fetch_sub(1, std::memory_order_relaxed);
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t align) noexcept {
+    operator delete(ptr, align);
+}
+
+// Slots freed on another thread come back to the owner once its own free
+// list runs dry, so a producer/consumer pair stops growing the pool.
+void TestRemoteFreesAreReused() {
+    constexpr int kSlots = 1000;
+    std::vector<void*> first;
+    std::vector<void*> second;
+    std::thread owner([&] {
+        for (int i = 0; i < kSlots; ++i) {
+            void* slot = Pool::Allocate();
+            CHECK(reinterpret_cast<std::uintptr_t>(slot) % 16 == 0);
+            first.push_back(slot);
+        }
+        std::thread([&] {
+            for (void* slot : first) {
+                Pool::Deallocate(slot);
+            }
+        }).join();
+        for (int i = 0; i < kSlots; ++i) {
+            second.push_back(Pool::Allocate());
+        }
+        for (void* slot : second) {
+            Pool::Deallocate(slot);
+        }
+    });
+    owner.join();
+    std::sort(first.begin(), first.end());
+    std::sort(second.begin(), second.end());
+    CHECK(first == second);
+}
+
+// Producers adopt raw pointers and hand the SharedPtrs to consumers, which
+// drop them while the producers keep allocating.
+void TestProducerConsumer() {
+    constexpr int kProducers = 2;
+    constexpr int kItems = 2000;
+    std::atomic<int> destroyed = 0;
+    struct Item {
+        std::atomic<int>* destroyed;
+
+        ~Item() {
+            destroyed->fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int p = 0; p < kProducers; ++p) {
+        std::vector<SharedPtr<Item>> batch;
+        std::thread producer([&] {
+            for (int i = 0; i < kItems; ++i) {
+                batch.push_back(SharedPtr<Item>(new Item { &destroyed }));
+            }
+        });
+        producer.join();
+        threads.emplace_back([batch = std::move(batch)]() mutable {
+            while (!batch.empty()) {
+                batch.pop_back();
+            }
+        });
+        threads.emplace_back([&] {
+            for (int i = 0; i < kItems; ++i) {
+                SharedPtr<Item> local(new Item { &destroyed });
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CHECK(destroyed == 2 * kProducers * kItems);
+}
+
+std::atomic<int> late_destroyed = 0;
+
+struct Late {
+    ~Late() {
+        late_destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+// Allocates from a thread_local destructor, after the thread's pool may
+// already have been torn down.
+struct AllocatesOnExit {
+    ~AllocatesOnExit() {
+        SharedPtr<Late> late(new Late());
+        SharedPtr<Late> copy = late;
+    }
+};
+
+// Blocks may outlive the thread that allocated them, and a thread may still
+// adopt pointers while its storage is being destroyed.
+void TestThreadExit() {
+    std::optional<SharedPtr<Late>> survivor;
+    std::thread([&] {
+        thread_local AllocatesOnExit allocates_on_exit;
+        static_cast<void>(&allocates_on_exit);
+        survivor.emplace(new Late());
+        SharedPtr<Late> dropped(new Late());
+    }).join();
+    CHECK(late_destroyed == 2);
+    CHECK(survivor->use_count() == 1);
+    survivor.reset();
+    CHECK(late_destroyed == 3);
+}
+
+// A pool left behind by its thread is freed with the last block taken from
+// it, which here is released on another thread.
+void TestOrphanedPoolIsFreed() {
+    int slabs = live_slabs;
+    std::vector<SharedPtr<Late>> kept;
+    std::thread([&] {
+        for (int i = 0; i < 1000; ++i) {
+            kept.push_back(SharedPtr<Late>(new Late()));
+        }
+    }).join();
+    CHECK(live_slabs > slabs);
+    kept.pop_back();
+    CHECK(live_slabs > slabs);
+    kept.clear();
+    CHECK(live_slabs == slabs);
+
+    // The pool made during thread teardown has no owner at all.
+    std::thread([] {
+        thread_local AllocatesOnExit allocates_on_exit;
+        static_cast<void>(&allocates_on_exit);
+    }).join();
+    CHECK(live_slabs == slabs);
+}
+
+int main() {
+    TestRemoteFreesAreReused();
+    TestProducerConsumer();
+    TestThreadExit();
+    TestOrphanedPoolIsFreed();
+    return 0;
+}
@@ -0,0 +1,165 @@
+// g++ -std=c++20 -g -fsanitize=address,undefined -I. tests/intrusive_list_test.cpp && ./a.out
+
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "IntrusiveList.h"
+#include "tests/check.h"
+
+// Hooks sit after other members, so converting a hook back to its object
+// has to subtract a non-zero offset.
+struct Task {
+    std::string name;
+    int id;
+    IntrusiveListHook<> queue_hook;
+    IntrusiveListHook<LinkMode::kSafe> safe_hook;
+    IntrusiveListHook<LinkMode::kAutoUnlink> auto_hook;
+
+    explicit Task(int id) : name("task" + std::to_string(id)), id(id) {
+    }
+};
+
+using Queue = IntrusiveList<Task, &Task::queue_hook>;
+using SafeQueue = IntrusiveList<Task, &Task::safe_hook>;
+using AutoQueue = IntrusiveList<Task, &Task::auto_hook>;
+
+template <typename L>
+std::vector<int> Ids(const L& list) {
+    std::vector<int> ids;
+    for (const Task& task : list) {
+        ids.push_back(task.id);
+    }
+    std::vector<int> backwards;
+    for (auto it = list.rbegin(); it != list.rend(); ++it) {
+        backwards.insert(backwards.begin(), it->id);
+    }
+    CHECK(ids == backwards);
+    CHECK(ids.size() == list.size());
+    return ids;
+}
+
+void TestPushEraseSplice() {
+    std::vector<std::unique_ptr<Task>> tasks;
+    for (int i = 0; i < 6; ++i) {
+        tasks.push_back(std::make_unique<Task>(i));
+    }
+    Queue queue;
+    CHECK(queue.empty() && queue.size() == 0);
+    queue.push_back(*tasks[1]);
+    queue.push_back(*tasks[2]);
+    queue.push_front(*tasks[0]);
+    CHECK((Ids(queue) == std::vector<int> { 0, 1, 2 }));
+    CHECK(&queue.front() == tasks[0].get() && &queue.back() == tasks[2].get());
+    CHECK(queue.front().name == "task0");
+
+    auto next = queue.erase(queue.iterator_to(*tasks[1]));
+    CHECK(&*next == tasks[2].get());
+    CHECK((Ids(queue) == std::vector<int> { 0, 2 }));
+    queue.insert(next, *tasks[1]);
+    CHECK((Ids(queue) == std::vector<int> { 0, 1, 2 }));
+
+    Queue other;
+    other.push_back(*tasks[3]);
+    other.push_back(*tasks[4]);
+    queue.splice(queue.iterator_to(*tasks[1]), other);
+    CHECK(other.empty() && other.size() == 0);
+    CHECK((Ids(queue) == std::vector<int> { 0, 3, 4, 1, 2 }));
+
+    Queue moved(std::move(queue));
+    CHECK(queue.empty());
+    CHECK((Ids(moved) == std::vector<int> { 0, 3, 4, 1, 2 }));
+    moved.pop_front();
+    moved.pop_back();
+    CHECK((Ids(moved) == std::vector<int> { 3, 4, 1 }));
+
+    // The same objects can sit in several lists at once through other hooks.
+    SafeQueue safe;
+    for (auto& task : tasks) {
+        safe.push_back(*task);
+    }
+    CHECK((Ids(safe) == std::vector<int> { 0, 1, 2, 3, 4, 5 }));
+    CHECK((Ids(moved) == std::vector<int> { 3, 4, 1 }));
+}
+
+// Safe hooks refuse a second insertion and are marked unlinked on erase
+// and clear.
+void TestSafeMode() {
+    Task a(1);
+    Task b(2);
+    SafeQueue queue;
+    queue.push_back(a);
+    bool threw = false;
+    try {
+        queue.push_back(a);
+    }
+    catch (const std::logic_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(queue.size() == 1);
+
+    SafeQueue other;
+    threw = false;
+    try {
+        other.push_back(a);
+    }
+    catch (const std::logic_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+
+    queue.push_back(b);
+    queue.erase(queue.begin());
+    CHECK(!a.safe_hook.is_linked() && b.safe_hook.is_linked());
+    other.push_back(a);
+    queue.clear();
+    CHECK(!b.safe_hook.is_linked());
+    CHECK(queue.empty() && queue.size() == 0);
+}
+
+// Objects leave an auto-unlink list when they are destroyed, and the list
+// counts what is actually linked.
+void TestAutoUnlink() {
+    AutoQueue queue;
+    std::vector<std::optional<Task>> tasks(5);
+    for (int i = 0; i < 5; ++i) {
+        tasks[i].emplace(i);
+        queue.push_back(*tasks[i]);
+    }
+    CHECK(queue.size() == 5);
+    tasks[2].reset();
+    CHECK((Ids(queue) == std::vector<int> { 0, 1, 3, 4 }));
+    tasks[0].reset();
+    tasks[4].reset();
+    CHECK((Ids(queue) == std::vector<int> { 1, 3 }));
+    tasks[3]->auto_hook.unlink();
+    CHECK((Ids(queue) == std::vector<int> { 1 }));
+
+    AutoQueue other;
+    other.push_back(*tasks[3]);
+    other.splice(other.begin(), queue);
+    CHECK(queue.size() == 0);
+    CHECK((Ids(other) == std::vector<int> { 1, 3 }));
+    tasks[1].reset();
+    tasks[3].reset();
+    CHECK(other.empty() && other.size() == 0);
+
+    // A list destroyed first leaves its elements unlinked.
+    Task survivor(7);
+    {
+        AutoQueue scoped;
+        scoped.push_back(survivor);
+        CHECK(survivor.auto_hook.is_linked());
+    }
+    CHECK(!survivor.auto_hook.is_linked());
+}
+
+int main() {
+    TestPushEraseSplice();
+    TestSafeMode();
+    TestAutoUnlink();
+    return 0;
+}
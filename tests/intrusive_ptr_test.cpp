@@ -0,0 +1,108 @@
+// g++ -std=c++20 -g -fsanitize=address,undefined -I. tests/intrusive_ptr_test.cpp && ./a.out
+
+#include <utility>
+
+#include "intrusive_ptr.h"
+#include "tests/check.h"
+
+int destroyed = 0;
+
+template <typename Policy>
+struct Counted : IntrusiveRefCounted<Counted<Policy>, Policy> {
+    int value;
+
+    explicit Counted(int value) : value(value) {
+    }
+
+    virtual ~Counted() {
+        ++destroyed;
+    }
+};
+
+template <typename Policy>
+struct Derived : Counted<Policy> {
+    explicit Derived(int value) : Counted<Policy>(value) {
+    }
+};
+
+template <typename Policy>
+void TestCopiesAndMoves() {
+    using Ptr = IntrusivePtr<Counted<Policy>>;
+    destroyed = 0;
+    {
+        Ptr first = makeIntrusive<Counted<Policy>>(1);
+        CHECK(first->use_count() == 1);
+        Ptr copy = first;
+        CHECK(first->use_count() == 2 && copy.get() == first.get());
+        Ptr assigned;
+        assigned = copy;
+        CHECK(first->use_count() == 3);
+        Ptr moved = std::move(copy);
+        CHECK(!copy && first->use_count() == 3);
+        assigned = std::move(moved);
+        CHECK(!moved && first->use_count() == 2);
+        assigned = assigned;
+        CHECK(first->use_count() == 2);
+        assigned.reset();
+        CHECK(!assigned && first->use_count() == 1);
+        CHECK(destroyed == 0);
+    }
+    CHECK(destroyed == 1);
+}
+
+// The object goes away with its last reference, wherever that is dropped.
+template <typename Policy>
+void TestLastRelease() {
+    using Ptr = IntrusivePtr<Counted<Policy>>;
+    destroyed = 0;
+    Ptr a = makeIntrusive<Counted<Policy>>(1);
+    Ptr b = makeIntrusive<Counted<Policy>>(2);
+    Ptr a2 = a;
+    a = b;
+    CHECK(destroyed == 0 && b->use_count() == 2);
+    a2.reset(b.get());
+    CHECK(destroyed == 1 && b->use_count() == 3);
+    a.reset();
+    a2.reset();
+    CHECK(destroyed == 1 && b->use_count() == 1);
+    b = Ptr();
+    CHECK(destroyed == 2);
+}
+
+// Raw pointers convert both ways without touching the count unless asked to.
+template <typename Policy>
+void TestRawPointers() {
+    using Ptr = IntrusivePtr<Counted<Policy>>;
+    destroyed = 0;
+    Ptr owner = makeIntrusive<Counted<Policy>>(3);
+    Counted<Policy>* raw = owner.get();
+    Ptr rebuilt(raw);
+    CHECK(raw->use_count() == 2);
+    Counted<Policy>* detached = rebuilt.detach();
+    CHECK(!rebuilt && detached == raw && raw->use_count() == 2);
+    Ptr adopted(detached, false);
+    CHECK(raw->use_count() == 2);
+    owner.reset();
+    adopted.reset();
+    CHECK(destroyed == 1);
+
+    IntrusivePtr<Derived<Policy>> derived = makeIntrusive<Derived<Policy>>(4);
+    Ptr base = derived;
+    CHECK(base->use_count() == 2 && base == derived);
+    Ptr stolen = std::move(derived);
+    CHECK(!derived && stolen->use_count() == 2 && stolen->value == 4);
+    base.reset();
+    stolen.reset();
+    CHECK(destroyed == 2);
+}
+
+int main() {
+    static_assert(sizeof(IntrusivePtr<Counted<AtomicRefCount>>) == sizeof(void*));
+    TestCopiesAndMoves<AtomicRefCount>();
+    TestCopiesAndMoves<SingleThreadRefCount>();
+    TestLastRelease<AtomicRefCount>();
+    TestLastRelease<SingleThreadRefCount>();
+    TestRawPointers<AtomicRefCount>();
+    TestRawPointers<SingleThreadRefCount>();
+    return 0;
+}
@@ -0,0 +1,468 @@
+// g++ -std=c++20 -g -fsanitize=address,undefined -I. tests/list_test.cpp && ./a.out
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "PoolAllocator.h"
+#include "StackAllocator.h"
+#include "tests/check.h"
+#include "tests/test_util.h"
+
+// Records the size of every request and can be told to fail after a number
+// of allocations.
+struct AllocationLog {
+    std::size_t allocations = 0;
+    std::size_t live = 0;
+    std::size_t fail_after = static_cast<std::size_t>(-1);
+    std::vector<std::size_t> sizes;
+    // Memory handed out in bulk-release mode, freed with the log.
+    std::vector<std::unique_ptr<char[]>> blocks;
+};
+
+// With Bulk it declares bulk_release like an arena does: deallocate() only
+// updates the count and the memory goes away with the log.
+template <typename T, bool Bulk = false>
+struct LoggingAllocator {
+    using value_type = T;
+
+    static constexpr bool bulk_release = Bulk;
+
+    AllocationLog* log;
+
+    explicit LoggingAllocator(AllocationLog* log) noexcept : log(log) {
+    }
+
+    template <typename U>
+    LoggingAllocator(const LoggingAllocator<U, Bulk>& other) noexcept : log(other.log) {
+    }
+
+    T* allocate(std::size_t n) {
+        if (log->allocations == log->fail_after) {
+            throw std::bad_alloc();
+        }
+        ++log->allocations;
+        log->live += n;
+        log->sizes.push_back(n * sizeof(T));
+        if constexpr (Bulk) {
+            log->blocks.emplace_back(new char[n * sizeof(T)]);
+            return reinterpret_cast<T*>(log->blocks.back().get());
+        }
+        else {
+            return std::allocator<T>().allocate(n);
+        }
+    }
+
+    void deallocate(T* ptr, std::size_t n) noexcept {
+        log->live -= n;
+        if constexpr (!Bulk) {
+            std::allocator<T>().deallocate(ptr, n);
+        }
+    }
+
+    template <typename U>
+    struct rebind {
+        using other = LoggingAllocator<U, Bulk>;
+    };
+
+    template <typename U>
+    bool operator==(const LoggingAllocator<U, Bulk>& other) const noexcept {
+        return log == other.log;
+    }
+};
+
+// Applies the same random operations to a List and a std::list.
+template <typename T, typename Alloc, typename Make>
+void Fuzz(Alloc alloc, Make make, unsigned seed, int steps) {
+    std::mt19937 rng(seed);
+    auto pick = [&rng](std::size_t bound) {
+        return std::uniform_int_distribution<std::size_t>(0, bound)(rng);
+    };
+    List<T, Alloc> list(alloc);
+    List<T, Alloc> other(alloc);
+    std::list<T> expected;
+    std::list<T> expected_other;
+    for (int step = 0; step < steps; ++step) {
+        T value = make(rng());
+        switch (pick(16)) {
+        case 0:
+            list.push_back(value);
+            expected.push_back(value);
+            break;
+        case 1:
+            list.emplace_front(value);
+            expected.push_front(value);
+            break;
+        case 2: {
+            std::size_t at = pick(expected.size());
+            list.insert(Advance(list.begin(), at), value);
+            expected.insert(Advance(expected.begin(), at), value);
+            break;
+        }
+        case 3:
+            if (!expected.empty()) {
+                std::size_t at = pick(expected.size() - 1);
+                list.erase(Advance(list.begin(), at));
+                expected.erase(Advance(expected.begin(), at));
+            }
+            break;
+        case 4:
+            if (!expected.empty()) {
+                list.pop_back();
+                expected.pop_back();
+            }
+            break;
+        case 5: {
+            std::vector<T> values(pick(20), value);
+            std::size_t at = pick(expected.size());
+            list.insert(Advance(list.begin(), at), values.begin(), values.end());
+            expected.insert(Advance(expected.begin(), at), values.begin(), values.end());
+            break;
+        }
+        case 6:
+            other.push_back(value);
+            expected_other.push_back(value);
+            break;
+        case 7: {
+            std::size_t at = pick(expected.size());
+            list.splice(Advance(list.begin(), at), other);
+            expected.splice(Advance(expected.begin(), at), expected_other);
+            break;
+        }
+        case 8:
+            if (!expected_other.empty()) {
+                std::size_t at = pick(expected.size());
+                std::size_t from = pick(expected_other.size() - 1);
+                list.splice(Advance(list.begin(), at), other, Advance(other.begin(), from));
+                expected.splice(Advance(expected.begin(), at), expected_other, Advance(expected_other.begin(), from));
+            }
+            break;
+        case 9:
+            if (!expected.empty()) {
+                std::size_t first = pick(expected.size() - 1);
+                std::size_t last = first + pick(expected.size() - first);
+                other.splice(other.end(), list, Advance(list.begin(), first), Advance(list.begin(), last));
+                expected_other.splice(expected_other.end(), expected, Advance(expected.begin(), first),
+                                      Advance(expected.begin(), last));
+            }
+            break;
+        case 10: {
+            List<T, Alloc> copy(list);
+            CheckSame(copy, expected);
+            List<T, Alloc> moved(std::move(copy));
+            CheckSame(moved, expected);
+            CHECK(copy.size() == 0);
+            break;
+        }
+        case 11:
+            list.compact();
+            break;
+        case 12:
+            list.sort();
+            expected.sort();
+            other.sort();
+            expected_other.sort();
+            list.merge(other);
+            expected.merge(expected_other);
+            break;
+        case 13:
+            list.reverse();
+            expected.reverse();
+            break;
+        case 14:
+            CHECK(list.unique() == expected.unique());
+            break;
+        case 15:
+            CHECK(list.remove_if([&value](const T& item) { return item < value; }) ==
+                  expected.remove_if([&value](const T& item) { return item < value; }));
+            break;
+        default:
+            if (pick(20) == 0) {
+                list.clear();
+                expected.clear();
+            }
+            break;
+        }
+        CheckSame(list, expected);
+        CheckSame(other, expected_other);
+    }
+}
+
+void TestDifferential() {
+    for (unsigned seed = 1; seed <= 3; ++seed) {
+        Fuzz<int>(std::allocator<int>(), Int, seed, 2000);
+        Fuzz<std::string>(std::allocator<std::string>(), String, seed, 2000);
+        Fuzz<int>(PoolAllocator<int>(), Int, seed, 2000);
+        // Copies are never given back to the arena, so it has to be large.
+        MmapStackStorage storage(std::size_t(1) << 30);
+        Fuzz<std::string>(MmapStackAllocator<std::string>(storage), String, seed, 2000);
+    }
+}
+
+struct PlainIntNode {
+    ListBaseNode links;
+    int value;
+};
+
+// A node is the two links and the value, however it was built; runs of
+// nodes come only from allocators that release in bulk.
+void TestNodeLayout() {
+    AllocationLog log;
+    {
+        LoggingAllocator<int> alloc(&log);
+        List<int, LoggingAllocator<int>> list(200, 7, alloc);
+        list.push_back(8);
+        std::vector<int> values(50, 9);
+        list.insert(list.begin(), values.begin(), values.end());
+        CHECK(list.size() == 251);
+        CHECK(log.allocations == 251);
+        for (std::size_t size : log.sizes) {
+            CHECK(size == sizeof(PlainIntNode));
+        }
+    }
+    CHECK(log.live == 0);
+
+    auto storage = std::make_unique<StackStorage<(1 << 20)>>();
+    StackAllocator<int, (1 << 20)> arena(*storage);
+    List<int, StackAllocator<int, (1 << 20)>> list(200, 7, arena);
+    auto first = reinterpret_cast<std::uintptr_t>(&*list.begin());
+    std::size_t i = 0;
+    for (int& value : list) {
+        // Consecutive slots of one run.
+        if (i < 64) {
+            CHECK(reinterpret_cast<std::uintptr_t>(&value) - first == i * sizeof(PlainIntNode));
+        }
+        ++i;
+    }
+}
+
+std::list<std::string> FailureValues() {
+    std::list<std::string> values;
+    for (unsigned i = 0; i < 100; ++i) {
+        values.push_back(String(i * 7 + 1));
+    }
+    return values;
+}
+
+// Fails the k-th allocation of a bulk build for every k; the list must come
+// out as it went in and nothing may leak.
+void TestAllocationFailure() {
+    std::list<std::string> expected = FailureValues();
+    AllocationLog log;
+    LoggingAllocator<std::string> alloc(&log);
+    List<std::string, LoggingAllocator<std::string>> list(alloc);
+    list.insert(list.end(), expected.begin(), expected.end());
+    std::vector<std::string> values(30, "inserted");
+    for (std::size_t k = 0; k < 100; ++k) {
+        log.fail_after = log.allocations + k % 30;
+        bool threw = false;
+        try {
+            list.insert(Advance(list.begin(), k), values.begin(), values.end());
+        }
+        catch (const std::bad_alloc&) {
+            threw = true;
+        }
+        CHECK(threw);
+        CheckSame(list, expected);
+        CHECK(log.live == 100);
+    }
+}
+
+// The same for compact(), which only rebuilds lists whose allocator
+// releases in bulk; a partial rebuild may leave unused slots behind, which
+// the arena reclaims, but must not lose or duplicate an element.
+void TestCompactFailure() {
+    std::list<std::string> expected = FailureValues();
+    AllocationLog log;
+    LoggingAllocator<std::string, true> alloc(&log);
+    List<std::string, LoggingAllocator<std::string, true>> list(alloc);
+    list.insert(list.end(), expected.begin(), expected.end());
+    // Raises k until compact() needs no more than k allocations.
+    std::size_t k = 0;
+    for (bool threw = true; threw; ++k) {
+        log.fail_after = log.allocations + k;
+        threw = false;
+        try {
+            CHECK(list.compact());
+        }
+        catch (const std::bad_alloc&) {
+            threw = true;
+        }
+        CheckSame(list, expected);
+    }
+    CHECK(k > 1);
+}
+
+// After compact() an arena list sits in consecutive slots in list order,
+// runs of them following each other; a heap list is left alone.
+void TestCompactLayout() {
+    auto storage = std::make_unique<StackStorage<(1 << 20)>>();
+    StackAllocator<int, (1 << 20)> arena(*storage);
+    List<int, StackAllocator<int, (1 << 20)>> list(arena);
+    List<int, StackAllocator<int, (1 << 20)>> other(arena);
+    for (int i = 0; i < 300; ++i) {
+        list.push_front(i);
+        other.push_back(i);
+    }
+    list.sort();
+    CHECK(list.compact());
+    std::vector<std::uintptr_t> addresses;
+    for (int& value : list) {
+        addresses.push_back(reinterpret_cast<std::uintptr_t>(&value));
+    }
+    CHECK(addresses.size() == 300);
+    for (std::size_t i = 1; i < addresses.size(); ++i) {
+        CHECK(addresses[i] > addresses[i - 1]);
+        if (i % 64 != 0) {
+            CHECK(addresses[i] - addresses[i - 1] == sizeof(PlainIntNode));
+        }
+    }
+    CHECK(std::is_sorted(list.begin(), list.end()));
+
+    List<int> heap;
+    for (int i = 0; i < 10; ++i) {
+        heap.push_back(i);
+    }
+    const int* first = &*heap.begin();
+    CHECK(!heap.compact());
+    CHECK(&*heap.begin() == first);
+}
+
+struct Keyed {
+    int key;
+    int order;
+};
+
+// sort() and merge() are stable and only relink nodes, so element addresses
+// survive; a throwing comparison loses no element.
+void TestStableRelinking() {
+    std::mt19937 rng(7);
+    List<Keyed> list;
+    std::list<Keyed> expected;
+    for (int i = 0; i < 1000; ++i) {
+        Keyed value { static_cast<int>(rng() % 50), i };
+        list.push_back(value);
+        expected.push_back(value);
+    }
+    std::vector<const Keyed*> addresses;
+    for (const Keyed& value : list) {
+        addresses.push_back(&value);
+    }
+    auto by_key = [](const Keyed& a, const Keyed& b) {
+        return a.key < b.key;
+    };
+    list.sort(by_key);
+    expected.sort(by_key);
+    CHECK(std::equal(list.begin(), list.end(), expected.begin(), expected.end(),
+                     [](const Keyed& a, const Keyed& b) { return a.key == b.key && a.order == b.order; }));
+    for (const Keyed& value : list) {
+        CHECK(addresses[value.order] == &value);
+    }
+
+    int calls = 0;
+    try {
+        list.sort([&calls](const Keyed& a, const Keyed& b) {
+            if (++calls == 3000) {
+                throw std::runtime_error("comparison");
+            }
+            return a.order < b.order;
+        });
+        CHECK(false);
+    }
+    catch (const std::runtime_error&) {
+    }
+    CHECK(list.size() == 1000);
+    std::vector<bool> seen(1000);
+    for (const Keyed& value : list) {
+        CHECK(addresses[value.order] == &value);
+        CHECK(!seen[value.order]);
+        seen[value.order] = true;
+    }
+    std::vector<const Keyed*> forward;
+    for (const Keyed& value : list) {
+        forward.push_back(&value);
+    }
+    CHECK(std::equal(list.rbegin(), list.rend(), forward.rbegin(), forward.rend(),
+                     [](const Keyed& value, const Keyed* address) { return &value == address; }));
+}
+
+// Counts destructor calls, so it is not trivially destructible.
+struct Destructible {
+    static inline int destroyed = 0;
+    int value;
+
+    explicit Destructible(int value) : value(value) {
+    }
+
+    ~Destructible() {
+        ++destroyed;
+    }
+};
+
+// clear() and the destructor forget the nodes of a bulk-release list only
+// when T is trivially destructible; otherwise every element is destroyed and
+// every node handed back.
+void TestDropNodes() {
+    AllocationLog log;
+    {
+        List<int, LoggingAllocator<int, true>> list(100, 1, LoggingAllocator<int, true>(&log));
+        std::size_t live = log.live;
+        CHECK(live >= 100);
+        list.clear();
+        CHECK(list.size() == 0 && list.begin() == list.end());
+        CHECK(log.live == live);
+        list.push_back(2);
+        CHECK(list.size() == 1 && *list.begin() == 2);
+    }
+    CHECK(log.live > 0);
+
+    AllocationLog destructible_log;
+    {
+        LoggingAllocator<Destructible, true> alloc(&destructible_log);
+        List<Destructible, LoggingAllocator<Destructible, true>> list(alloc);
+        for (int i = 0; i < 100; ++i) {
+            list.emplace_back(i);
+        }
+        Destructible::destroyed = 0;
+        list.clear();
+        CHECK(Destructible::destroyed == 100 && destructible_log.live == 0);
+        list.emplace_back(100);
+    }
+    CHECK(Destructible::destroyed == 101 && destructible_log.live == 0);
+
+    AllocationLog heap_log;
+    {
+        List<int, LoggingAllocator<int>> list(100, 1, LoggingAllocator<int>(&heap_log));
+        list.clear();
+        CHECK(heap_log.live == 0);
+    }
+
+    // Nodes that spilled to the upstream resource must go back to it even
+    // for trivial T; dropping them would show up as a leak under ASan.
+    auto storage = std::make_unique<StackStorage<256>>();
+    StackMemoryResource<StackStorage<256>> resource(*storage, std::pmr::new_delete_resource());
+    using Alloc = StackAllocator<int, 256>;
+    List<int, Alloc> spilled { Alloc(resource) };
+    for (int i = 0; i < 100; ++i) {
+        spilled.push_back(i);
+    }
+    spilled.clear();
+    spilled.push_back(1);
+}
+
+int main() {
+    TestDifferential();
+    TestNodeLayout();
+    TestAllocationFailure();
+    TestCompactFailure();
+    TestCompactLayout();
+    TestStableRelinking();
+    TestDropNodes();
+    return 0;
+}
@@ -0,0 +1,215 @@
+// g++ -std=c++20 -g -fsanitize=address,undefined -I. tests/lru_cache_test.cpp && ./a.out
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "LruCache.h"
+#include "PoolAllocator.h"
+#include "tests/check.h"
+
+// Reference model: a std::list in recency order, searched linearly.
+struct Model {
+    std::size_t capacity;
+    std::list<std::pair<int, std::string>> entries;
+    std::vector<int> evicted;
+
+    std::list<std::pair<int, std::string>>::iterator Find(int key) {
+        return std::find_if(entries.begin(), entries.end(), [key](const auto& entry) {
+            return entry.first == key;
+        });
+    }
+
+    const std::string* find(int key) {
+        auto it = Find(key);
+        if (it == entries.end()) {
+            return nullptr;
+        }
+        entries.splice(entries.begin(), entries, it);
+        return &it->second;
+    }
+
+    void put(int key, const std::string& value) {
+        if (auto it = Find(key); it != entries.end()) {
+            it->second = value;
+            entries.splice(entries.begin(), entries, it);
+            return;
+        }
+        if (entries.size() == capacity) {
+            evicted.push_back(entries.back().first);
+            entries.pop_back();
+        }
+        entries.emplace_front(key, value);
+    }
+
+    bool erase(int key) {
+        auto it = Find(key);
+        if (it == entries.end()) {
+            return false;
+        }
+        entries.erase(it);
+        return true;
+    }
+};
+
+// Few buckets, so probe chains are long and erase has to close real gaps.
+struct CollidingHash {
+    std::size_t operator()(int key) const noexcept {
+        return static_cast<std::size_t>(key % 3);
+    }
+};
+
+template <typename Cache>
+void CheckSame(const Cache& cache, const Model& model) {
+    CHECK(cache.size() == model.entries.size());
+    CHECK(std::equal(cache.begin(), cache.end(), model.entries.begin(), model.entries.end()));
+    for (const auto& [key, value] : model.entries) {
+        const std::string* found = cache.peek(key);
+        CHECK(found != nullptr && *found == value);
+    }
+}
+
+template <typename Cache, typename Alloc>
+void Fuzz(std::size_t capacity, Alloc alloc, unsigned seed, int steps) {
+    std::mt19937 rng(seed);
+    auto pick = [&rng](std::size_t bound) {
+        return std::uniform_int_distribution<std::size_t>(0, bound)(rng);
+    };
+    Model model { capacity, {}, {} };
+    std::vector<int> evicted;
+    Cache cache(capacity, [&evicted](const int& key, std::string&) { evicted.push_back(key); }, alloc);
+    for (int step = 0; step < steps; ++step) {
+        int key = static_cast<int>(pick(3 * capacity));
+        std::string value = std::to_string(rng());
+        switch (pick(6)) {
+        case 0:
+        case 1:
+            CHECK(cache.put(key, value) == value);
+            model.put(key, value);
+            break;
+        case 2: {
+            std::string* found = cache.find(key);
+            const std::string* expected = model.find(key);
+            CHECK((found == nullptr) == (expected == nullptr));
+            CHECK(found == nullptr || *found == *expected);
+            break;
+        }
+        case 3:
+            CHECK(cache.contains(key) == (model.Find(key) != model.entries.end()));
+            break;
+        case 4:
+            CHECK(cache.erase(key) == model.erase(key));
+            break;
+        case 5: {
+            Cache copy(cache);
+            CheckSame(copy, model);
+            Cache moved(std::move(copy));
+            CheckSame(moved, model);
+            CHECK(copy.size() == 0 && copy.capacity() == 0);
+            break;
+        }
+        default:
+            if (pick(50) == 0) {
+                cache.clear();
+                model.entries.clear();
+            }
+            break;
+        }
+        CheckSame(cache, model);
+        CHECK(evicted == model.evicted);
+    }
+}
+
+void TestDifferential() {
+    for (unsigned seed = 1; seed <= 3; ++seed) {
+        for (std::size_t capacity : { 1, 2, 7, 64 }) {
+            using Pair = std::pair<int, std::string>;
+            Fuzz<LruCache<int, std::string>>(capacity, std::allocator<Pair>(), seed, 3000);
+            Fuzz<LruCache<int, std::string, std::allocator<Pair>, CollidingHash>>(capacity, std::allocator<Pair>(),
+                                                                                  seed, 3000);
+            Fuzz<LruCache<int, std::string, PoolAllocator<Pair>>>(capacity, PoolAllocator<Pair>(), seed, 3000);
+        }
+    }
+}
+
+void TestZeroCapacity() {
+    LruCache<int, int> cache(0);
+    CHECK(cache.find(1) == nullptr);
+    bool threw = false;
+    try {
+        cache.put(1, 1);
+    }
+    catch (const std::length_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(cache.size() == 0);
+}
+
+// Cannot be move-assigned, so put() evicts by erase and emplace.
+struct FixedKey {
+    const int id;
+
+    bool operator==(const FixedKey& other) const noexcept {
+        return id == other.id;
+    }
+};
+
+struct FixedKeyHash {
+    std::size_t operator()(const FixedKey& key) const noexcept {
+        return std::hash<int>()(key.id);
+    }
+};
+
+int Id(int key) {
+    return key;
+}
+
+int Id(const FixedKey& key) {
+    return key.id;
+}
+
+// An eviction callback that throws still evicts its entry, and the entry
+// is neither counted by size() nor evicted again.
+template <typename K, typename Hash>
+void TestThrowingCallback() {
+    std::vector<int> evicted;
+    LruCache<K, int, std::allocator<std::pair<K, int>>, Hash> cache(2, [&evicted](const K& key, int&) {
+        evicted.push_back(Id(key));
+        if (Id(key) == 1) {
+            throw std::runtime_error("evict");
+        }
+    });
+    cache.put(K { 1 }, 1);
+    cache.put(K { 2 }, 2);
+    bool threw = false;
+    try {
+        cache.put(K { 3 }, 3);
+    }
+    catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(cache.size() == 1);
+    CHECK(!cache.contains(K { 1 }) && cache.find(K { 1 }) == nullptr);
+    CHECK(!cache.contains(K { 3 }));
+    CHECK(cache.contains(K { 2 }));
+    cache.put(K { 4 }, 4);
+    CHECK(cache.size() == 2);
+    cache.put(K { 5 }, 5);
+    CHECK(cache.size() == 2 && cache.contains(K { 4 }) && cache.contains(K { 5 }));
+    CHECK((evicted == std::vector<int> { 1, 2 }));
+}
+
+int main() {
+    TestDifferential();
+    TestZeroCapacity();
+    TestThrowingCallback<int, std::hash<int>>();
+    TestThrowingCallback<FixedKey, FixedKeyHash>();
+    return 0;
+}
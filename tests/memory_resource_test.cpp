@@ -0,0 +1,148 @@
+// g++ -std=c++20 -g -fsanitize=address,undefined -I. tests/memory_resource_test.cpp && ./a.out
+
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "StackAllocator.h"
+#include "tests/check.h"
+
+// Upstream that counts live blocks and can be told to fail after a number
+// of allocations.
+class CountingResource : public std::pmr::memory_resource {
+public:
+    std::size_t allocations = 0;
+    std::size_t live = 0;
+    std::size_t fail_after = static_cast<std::size_t>(-1);
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        if (allocations == fail_after) {
+            throw std::bad_alloc();
+        }
+        ++allocations;
+        ++live;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override {
+        CHECK(live > 0);
+        --live;
+        std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+bool Aligned(const void* ptr, std::size_t alignment) {
+    return reinterpret_cast<std::uintptr_t>(ptr) % alignment == 0;
+}
+
+// Requests the arena cannot hold spill upstream; only those are ever given
+// back to it.
+template <typename Storage>
+void TestSpill(Storage& storage) {
+    CountingResource upstream;
+    {
+        StackMemoryResource<Storage> resource(storage, &upstream);
+        struct Block {
+            void* ptr;
+            std::size_t size;
+            std::size_t alignment;
+        };
+        std::vector<Block> blocks;
+        for (std::size_t alignment : { 1, 8, 64, 256 }) {
+            for (int i = 0; i < 40; ++i) {
+                std::size_t size = 100 + i * 37;
+                void* ptr = resource.allocate(size, alignment);
+                CHECK(Aligned(ptr, alignment));
+                blocks.push_back({ ptr, size, alignment });
+            }
+        }
+        CHECK(upstream.allocations > 0);
+        CHECK(upstream.live == upstream.allocations);
+        for (const Block& block : blocks) {
+            resource.deallocate(block.ptr, block.size, block.alignment);
+        }
+        CHECK(upstream.live == 0);
+    }
+    storage.reset();
+}
+
+// When both the arena and upstream are exhausted the container sees
+// std::bad_alloc and keeps its contents.
+void TestExhaustion() {
+    auto storage = std::make_unique<StackStorage<4096>>();
+    CountingResource upstream;
+    StackMemoryResource<StackStorage<4096>> resource(*storage, &upstream);
+    std::pmr::vector<std::pmr::string> strings(&resource);
+    upstream.fail_after = 3;
+    bool threw = false;
+    try {
+        for (int i = 0; i < 1000; ++i) {
+            strings.emplace_back(std::string(100, static_cast<char>('a' + i % 26)));
+        }
+    }
+    catch (const std::bad_alloc&) {
+        threw = true;
+    }
+    CHECK(threw);
+    for (std::size_t i = 0; i < strings.size(); ++i) {
+        CHECK(std::string_view(strings[i]) == std::string(100, static_cast<char>('a' + i % 26)));
+    }
+    strings.clear();
+    strings.shrink_to_fit();
+    CHECK(upstream.live == 0);
+
+    StackMemoryResource<StackStorage<4096>> closed(*storage, std::pmr::null_memory_resource());
+    threw = false;
+    try {
+        static_cast<void>(closed.allocate(8192, 8));
+    }
+    catch (const std::bad_alloc&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+// A List over a StackAllocator built from the resource spills the same way
+// and frees its spilled nodes one by one, even for trivially destructible
+// elements.
+void TestListFallback() {
+    using Storage = StackStorage<4096>;
+    auto storage = std::make_unique<Storage>();
+    CountingResource upstream;
+    StackMemoryResource<Storage> resource(*storage, &upstream);
+    {
+        StackAllocator<int, 4096> alloc(resource);
+        CHECK(!alloc.releases_in_bulk());
+        List<int, StackAllocator<int, 4096>> list(alloc);
+        for (int i = 0; i < 1000; ++i) {
+            list.push_back(i);
+        }
+        CHECK(upstream.live > 0);
+        for (int i = 0; i < 500; ++i) {
+            list.erase(list.begin());
+        }
+        List<int, StackAllocator<int, 4096>> more(1000, 7, alloc);
+    }
+    CHECK(upstream.live == 0);
+}
+
+int main() {
+    auto stack = std::make_unique<StackStorage<(1 << 14)>>();
+    TestSpill(*stack);
+    MmapStackStorage mmap(1 << 14);
+    TestSpill(mmap);
+    auto concurrent = std::make_unique<ConcurrentStackStorage<(1 << 14)>>(1024);
+    TestSpill(*concurrent);
+    TestExhaustion();
+    TestListFallback();
+    return 0;
+}
@@ -0,0 +1,89 @@
+// g++ -std=c++20 -g -fsanitize=address,undefined -I. tests/mmap_stack_storage_test.cpp && ./a.out
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "StackAllocator.h"
+#include "tests/check.h"
+
+const std::size_t kPage = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+
+// Resident pages in [begin, begin + bytes); begin is page aligned.
+std::size_t ResidentPages(void* begin, std::size_t bytes) {
+    std::vector<unsigned char> pages((bytes + kPage - 1) / kPage);
+    CHECK(mincore(begin, bytes, pages.data()) == 0);
+    std::size_t resident = 0;
+    for (unsigned char page : pages) {
+        resident += page & 1;
+    }
+    return resident;
+}
+
+// Reserving a large arena commits nothing; pages become resident only as
+// allocations touch them, and reset() gives them back.
+void TestLazyCommit() {
+    constexpr std::size_t kSize = std::size_t(1) << 30;
+    constexpr std::size_t kTouched = std::size_t(4) << 20;
+    MmapStackStorage storage(kSize);
+    CHECK(storage.capacity() == kSize);
+    auto first = static_cast<char*>(storage.allocate_raw(kPage, kTouched));
+    CHECK(first != nullptr && reinterpret_cast<std::uintptr_t>(first) % kPage == 0);
+    CHECK(ResidentPages(first, kSize) == 0);
+
+    std::memset(first, 1, kTouched);
+    std::size_t resident = ResidentPages(first, kSize);
+    CHECK(resident >= kTouched / kPage && resident < 2 * kTouched / kPage);
+
+    CHECK(storage.reset());
+    CHECK(ResidentPages(first, kSize) == 0);
+}
+
+// After reset() allocation starts over at the beginning of the range, and
+// the arena can be filled again as often as needed.
+void TestReuseAfterReset() {
+    MmapStackStorage storage(std::size_t(1) << 20);
+    char* base = nullptr;
+    for (int round = 0; round < 3; ++round) {
+        auto ptr = static_cast<char*>(storage.allocate_raw(16, 100));
+        CHECK(ptr != nullptr && storage.owns(ptr));
+        if (round == 0) {
+            base = ptr;
+        }
+        CHECK(ptr == base);
+        std::memset(ptr, round, 100);
+        std::size_t allocated = 100;
+        while (storage.allocate_raw(1, 4096) != nullptr) {
+            allocated += 4096;
+        }
+        CHECK(allocated > storage.capacity() - 4096 - 16);
+        CHECK(storage.reset());
+    }
+    CHECK(!storage.owns(base + storage.capacity()));
+
+    // A fresh arena has nothing to release.
+    MmapStackStorage unused(std::size_t(1) << 20);
+    CHECK(unused.reset());
+}
+
+// The advice is optional; without THP the storage still works.
+void TestHugePages() {
+    MmapStackStorage plain(std::size_t(1) << 22);
+    CHECK(!plain.huge_pages());
+    MmapStackStorage huge(std::size_t(1) << 22, true);
+    void* ptr = huge.allocate_raw(64, 1 << 21);
+    CHECK(ptr != nullptr);
+    std::memset(ptr, 0, 1 << 21);
+    CHECK(huge.reset());
+}
+
+int main() {
+    TestLazyCommit();
+    TestReuseAfterReset();
+    TestHugePages();
+    return 0;
+}
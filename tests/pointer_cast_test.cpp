@@ -0,0 +1,126 @@
+// g++ -std=c++20 -g -fsanitize=address,undefined -I. tests/pointer_cast_test.cpp && ./a.out
+
+#include <string>
+#include <utility>
+
+#include "shared_ptr.h"
+#include "tests/check.h"
+
+int destroyed = 0;
+
+struct Base {
+    int base_value = 1;
+
+    virtual ~Base() {
+        ++destroyed;
+    }
+};
+
+struct Derived : Base {
+    std::string name = "derived";
+    int values[2] = { 10, 20 };
+};
+
+struct Other : Base {
+};
+
+// An aliasing pointer shares the owner's count and keeps the whole object
+// alive through a pointer to one of its members.
+void TestAliasing() {
+    destroyed = 0;
+    SharedPtr<std::string> name;
+    {
+        SharedPtr<Derived> owner = makeShared<Derived>();
+        name = SharedPtr<std::string>(owner, &owner->name);
+        CHECK(owner.use_count() == 2 && name.use_count() == 2);
+        CHECK(name.get() == &owner->name);
+
+        SharedPtr<int> value(std::move(owner), &owner->values[1]);
+        CHECK(owner.get() == nullptr && value.use_count() == 2 && *value == 20);
+        WeakPtr<int> weak = value;
+        CHECK(weak.lock().get() == value.get());
+    }
+    CHECK(destroyed == 0 && *name == "derived");
+    name.reset();
+    CHECK(destroyed == 1);
+}
+
+// Assigning between pointers into the same block changes only the stored
+// pointer.
+void TestAssignWithinBlock() {
+    destroyed = 0;
+    {
+        SharedPtr<Derived> owner = makeShared<Derived>();
+        SharedPtr<int> first(owner, &owner->values[0]);
+        SharedPtr<int> second(owner, &owner->values[1]);
+        CHECK(owner.use_count() == 3);
+        first = second;
+        CHECK(owner.use_count() == 3 && *first == 20);
+        second = SharedPtr<int>(owner, &owner->base_value);
+        CHECK(owner.use_count() == 3 && *second == 1);
+        first = std::move(second);
+        CHECK(owner.use_count() == 2 && *first == 1);
+
+        WeakPtr<int> weak_first = first;
+        WeakPtr<int> weak_second = SharedPtr<int>(owner, &owner->values[0]);
+        weak_first = weak_second;
+        CHECK(*weak_first.lock() == 10);
+        CHECK(owner.use_count() == 2);
+    }
+    CHECK(destroyed == 1);
+}
+
+void TestCasts() {
+    destroyed = 0;
+    {
+        SharedPtr<Base> base = makeShared<Derived>();
+        SharedPtr<Derived> derived = staticPointerCast<Derived>(base);
+        CHECK(derived.get() == base.get() && base.use_count() == 2);
+        CHECK(derived->name == "derived");
+
+        SharedPtr<Derived> checked = dynamicPointerCast<Derived>(base);
+        CHECK(checked.get() == base.get() && base.use_count() == 3);
+        SharedPtr<Other> wrong = dynamicPointerCast<Other>(base);
+        CHECK(wrong.get() == nullptr && base.use_count() == 3);
+
+        SharedPtr<const Derived> constant = derived;
+        SharedPtr<Derived> mutable_again = constPointerCast<Derived>(constant);
+        mutable_again->values[0] = 11;
+        CHECK(constant->values[0] == 11 && base.use_count() == 5);
+
+        SharedPtr<char> bytes = reinterpretPointerCast<char>(base);
+        CHECK(static_cast<void*>(bytes.get()) == static_cast<void*>(base.get()));
+        CHECK(base.use_count() == 6);
+    }
+    CHECK(destroyed == 1);
+}
+
+// The rvalue casts take over the source's reference, except for a failed
+// dynamic cast, which leaves the source alone.
+void TestMovingCasts() {
+    destroyed = 0;
+    SharedPtr<Base> base = makeShared<Derived>();
+    SharedPtr<Base> source = base;
+    SharedPtr<Other> wrong = dynamicPointerCast<Other>(std::move(source));
+    CHECK(wrong.get() == nullptr && source.get() != nullptr && base.use_count() == 2);
+
+    SharedPtr<Derived> derived = dynamicPointerCast<Derived>(std::move(source));
+    CHECK(source.get() == nullptr && derived.get() != nullptr && base.use_count() == 2);
+    SharedPtr<Base> back = staticPointerCast<Base>(std::move(derived));
+    CHECK(derived.get() == nullptr && back.get() == base.get() && base.use_count() == 2);
+    SharedPtr<const Base> constant = std::move(back);
+    SharedPtr<Base> unconst = constPointerCast<Base>(std::move(constant));
+    CHECK(constant.get() == nullptr && base.use_count() == 2);
+    base.reset();
+    CHECK(destroyed == 0);
+    unconst.reset();
+    CHECK(destroyed == 1);
+}
+
+int main() {
+    TestAliasing();
+    TestAssignWithinBlock();
+    TestCasts();
+    TestMovingCasts();
+    return 0;
+}
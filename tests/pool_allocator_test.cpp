@@ -0,0 +1,48 @@
+// g++ -std=c++20 -g -fsanitize=address,undefined -I. tests/pool_allocator_test.cpp && ./a.out
+
+#include <utility>
+
+#include "PoolAllocator.h"
+#include "StackAllocator.h"
+#include "tests/check.h"
+
+using PoolList = List<int, PoolAllocator<int>>;
+
+// A moved-from allocator still refers to the pool and compares equal to the
+// one it was moved into.
+void TestMovedFromAllocator() {
+    PoolAllocator<int> alloc;
+    PoolAllocator<int> moved(std::move(alloc));
+    CHECK(alloc == moved);
+    int* ptr = alloc.allocate(1);
+    moved.deallocate(ptr, 1);
+
+    PoolAllocator<int> assigned;
+    assigned = std::move(moved);
+    CHECK(assigned == moved);
+    CHECK(assigned == alloc);
+}
+
+// A list keeps working after its nodes and allocator have been moved away.
+void TestMovedFromList() {
+    PoolList a;
+    a.push_back(1);
+    PoolList b(std::move(a));
+    CHECK(a.size() == 0);
+    a.push_back(2);
+    a.push_back(3);
+    CHECK(a.size() == 2 && *a.begin() == 2);
+    CHECK(b.size() == 1 && *b.begin() == 1);
+
+    PoolList c;
+    c = std::move(b);
+    b.push_back(4);
+    CHECK(b.size() == 1 && *b.begin() == 4);
+    CHECK(c.size() == 1 && *c.begin() == 1);
+}
+
+int main() {
+    TestMovedFromAllocator();
+    TestMovedFromList();
+    return 0;
+}
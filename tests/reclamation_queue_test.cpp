@@ -0,0 +1,134 @@
+// g++ -std=c++20 -g -fsanitize=thread -pthread -I. tests/reclamation_queue_test.cpp && ./a.out
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "reclamation_queue.h"
+#include "tests/check.h"
+
+constexpr int kThreads = 4;
+constexpr int kPerThread = 500;
+constexpr int kObjects = kThreads * kPerThread;
+
+std::atomic<int> destroyed_count[kObjects];
+
+struct Tracked {
+    int id;
+
+    explicit Tracked(int id) : id(id) {
+    }
+
+    ~Tracked() {
+        destroyed_count[id].fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+void ResetCounts() {
+    for (auto& count : destroyed_count) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+void CheckEach(int expected) {
+    for (auto& count : destroyed_count) {
+        CHECK(count.load(std::memory_order_relaxed) == expected);
+    }
+}
+
+// Threads drop the last reference to deferred objects; nothing is destroyed
+// before drain(), and drain() destroys each object once.
+void TestDeferUntilDrain() {
+    ResetCounts();
+    ReclamationQueue queue(kObjects);
+    std::vector<WeakPtr<Tracked>> weak(kObjects);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&queue, &weak, t] {
+            for (int i = t * kPerThread; i < (t + 1) * kPerThread; ++i) {
+                auto ptr = makeDeferredShared<Tracked>(queue, i);
+                weak[i] = ptr;
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CheckEach(0);
+    CHECK(queue.pending() == kObjects);
+    for (const auto& ptr : weak) {
+        CHECK(ptr.expired());
+    }
+    CHECK(queue.drain() == kObjects);
+    CheckEach(1);
+    CHECK(queue.drain() == 0);
+    CheckEach(1);
+}
+
+// Pool the objects come from; its deleter is a captured pointer.
+struct Pool {
+    std::atomic<int> released { 0 };
+
+    void Release(Tracked* ptr) {
+        released.fetch_add(1, std::memory_order_relaxed);
+        delete ptr;
+    }
+};
+
+// A ring smaller than the load makes retiring threads delete batches
+// themselves, while a background thread drains concurrently; objects retired
+// with a custom deleter go back through it.
+void TestBackpressureAndWorker() {
+    ResetCounts();
+    Pool pool;
+    {
+        ReclamationQueue queue(64);
+        queue.start();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&queue, &pool, t] {
+                auto to_pool = [&pool](Tracked* ptr) {
+                    pool.Release(ptr);
+                };
+                for (int i = t * kPerThread; i < (t + 1) * kPerThread; ++i) {
+                    if (i % 2 == 0) {
+                        queue.retire(new Tracked(i), to_pool);
+                    }
+                    else {
+                        queue.retire(new Tracked(i));
+                    }
+                    CHECK(queue.pending() <= queue.capacity());
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        queue.stop();
+        queue.drain();
+        CHECK(queue.pending() == 0);
+        CheckEach(1);
+    }
+    CHECK(pool.released == kObjects / 2);
+}
+
+// Whatever is still queued when the queue goes away is destroyed then.
+void TestDestructorDrains() {
+    ResetCounts();
+    {
+        ReclamationQueue queue(kObjects);
+        for (int i = 0; i < kObjects; ++i) {
+            queue.retire(new Tracked(i));
+        }
+        CheckEach(0);
+    }
+    CheckEach(1);
+}
+
+int main() {
+    TestDeferUntilDrain();
+    TestBackpressureAndWorker();
+    TestDestructorDrains();
+    return 0;
+}
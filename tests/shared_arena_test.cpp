@@ -0,0 +1,164 @@
+// g++ -std=c++20 -g -fsanitize=address,undefined -I. tests/shared_arena_test.cpp && ./a.out
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "StackAllocator.h"
+#include "shared_arena.h"
+#include "tests/check.h"
+#include "tests/test_util.h"
+
+using Arena = SharedArena<StackStorage<(1 << 16)>>;
+
+std::vector<std::string> events;
+
+struct Child {
+    std::string name;
+
+    explicit Child(std::string name) : name(std::move(name)) {
+    }
+
+    ~Child() {
+        events.push_back("~" + name);
+        name = "destroyed";
+    }
+};
+
+// Makes its child itself, so the child is the newer object, and reads it on
+// the way out.
+struct Parent {
+    Arena::Pointer<Child> child;
+
+    explicit Parent(Arena& arena) : child(arena.make<Child>("child")) {
+    }
+
+    ~Parent() {
+        events.push_back("~parent saw " + child->name);
+    }
+};
+
+// Built bottom-up: the child is older and already destroyed when this
+// destructor runs, so it only drops the pointer.
+struct Holder {
+    Arena::Pointer<Child> child;
+
+    ~Holder() {
+        events.push_back("~holder");
+    }
+};
+
+void TestCreationOrder() {
+    auto arena = std::make_unique<Arena>();
+    events.clear();
+    arena->make<Parent>(*arena);
+    arena->reset();
+    CHECK((events == std::vector<std::string>{ "~parent saw child", "~child" }));
+
+    events.clear();
+    auto child = arena->make<Child>("older");
+    arena->make<Holder>(Holder{ std::move(child) });
+    events.clear();
+    arena->reset();
+    CHECK((events == std::vector<std::string>{ "~older", "~holder" }));
+}
+
+struct Throws {
+    explicit Throws(Arena& arena) {
+        arena.make<Child>("inner");
+        throw std::runtime_error("constructor");
+    }
+
+    ~Throws() {
+        events.push_back("~throws");
+    }
+};
+
+// An object whose constructor throws is never destroyed; the ones it made
+// before throwing are.
+void TestThrowingConstructor() {
+    auto arena = std::make_unique<Arena>();
+    arena->make<Child>("before");
+    bool threw = false;
+    try {
+        arena->make<Throws>(*arena);
+    }
+    catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    arena->make<Child>("after");
+    events.clear();
+    arena->reset();
+    CHECK((events == std::vector<std::string>{ "~before", "~inner", "~after" }));
+}
+
+void TestReuse() {
+    auto arena = std::make_unique<Arena>();
+    for (int round = 0; round < 100; ++round) {
+        events.clear();
+        for (int i = 0; i < 10; ++i) {
+            arena->make<Child>(std::to_string(i));
+            arena->make<int>(i);
+        }
+        arena->reset();
+        CHECK(events.size() == 10);
+        for (int i = 0; i < 10; ++i) {
+            CHECK(events[i] == "~" + std::to_string(i));
+        }
+    }
+}
+
+// Counts behave as usual, but dropping the last reference destroys nothing
+// before reset().
+void TestCounts() {
+    auto arena = std::make_unique<Arena>();
+    events.clear();
+    Arena::WeakPointer<Child> weak;
+    {
+        Arena::Pointer<Child> ptr = arena->make<Child>("counted");
+        Arena::Pointer<Child> copy = ptr;
+        CHECK(ptr.use_count() == 2);
+        weak = copy;
+        CHECK(weak.lock().use_count() == 3);
+    }
+    CHECK(weak.expired() && TryLock(weak).get() == nullptr);
+    CHECK(events.empty());
+    weak = Arena::WeakPointer<Child>();
+    arena->reset();
+    CHECK((events == std::vector<std::string>{ "~counted" }));
+}
+
+// A reference that outlives reset() aborts a debug build with a message.
+void TestStrayReference() {
+    if constexpr (kSharedArenaChecks) {
+        pid_t child = fork();
+        CHECK(child >= 0);
+        if (child == 0) {
+            std::freopen("/dev/null", "w", stderr);
+            auto arena = std::make_unique<Arena>();
+            Arena::Pointer<int> kept = arena->make<int>(1);
+            arena->reset();
+            std::_Exit(0);
+        }
+        int status = 0;
+        CHECK(waitpid(child, &status, 0) == child);
+        CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+    }
+}
+
+int main() {
+    TestCreationOrder();
+    TestThrowingConstructor();
+    TestReuse();
+    TestCounts();
+    TestStrayReference();
+    return 0;
+}
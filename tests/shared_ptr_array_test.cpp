@@ -0,0 +1,169 @@
+// g++ -std=c++20 -g -fsanitize=address,undefined -I. tests/shared_ptr_array_test.cpp && ./a.out
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "shared_ptr.h"
+#include "tests/check.h"
+
+int allocations = 0;
+std::size_t allocated_bytes = 0;
+
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>&) noexcept {
+    }
+
+    T* allocate(std::size_t n) {
+        ++allocations;
+        allocated_bytes = n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* ptr, std::size_t n) noexcept {
+        --allocations;
+        std::allocator<T>().deallocate(ptr, n);
+    }
+
+    template <typename U>
+    bool operator==(const CountingAllocator<U>&) const noexcept {
+        return true;
+    }
+};
+
+std::vector<int> events;
+
+// Records its construction and destruction; the constructor of the element
+// numbered throw_at throws.
+struct Element {
+    static inline int next_id = 0;
+    static inline int throw_at = -1;
+    int id;
+
+    Element() : id(next_id++) {
+        if (id == throw_at) {
+            throw std::runtime_error("element");
+        }
+        events.push_back(id);
+    }
+
+    Element(const Element&) : Element() {
+    }
+
+    ~Element() {
+        events.push_back(-id - 1);
+    }
+};
+
+void ResetElements(int throw_at = -1) {
+    events.clear();
+    Element::next_id = 0;
+    Element::throw_at = throw_at;
+}
+
+// The elements follow the control block in the same allocation and are
+// value-initialized or copied from the given value.
+void TestSingleAllocation() {
+    {
+        auto ints = allocateShared<int[]>(CountingAllocator<int>(), 10);
+        CHECK(allocations == 1);
+        CHECK(allocated_bytes >= 10 * sizeof(int));
+        CHECK(allocated_bytes < 10 * sizeof(int) + 64);
+        for (int i = 0; i < 10; ++i) {
+            CHECK(ints[i] == 0);
+        }
+        ints[3] = 7;
+        SharedPtr<int[]> copy = ints;
+        CHECK(copy[3] == 7 && ints.use_count() == 2);
+    }
+    CHECK(allocations == 0);
+
+    auto strings = allocateShared<std::string[]>(CountingAllocator<std::string>(), 3, std::string(40, 'x'));
+    CHECK(allocations == 1);
+    for (int i = 0; i < 3; ++i) {
+        CHECK(strings[i] == std::string(40, 'x'));
+    }
+    strings.reset();
+    CHECK(allocations == 0);
+
+    auto fixed = makeShared<double[4]>(2.5);
+    for (int i = 0; i < 4; ++i) {
+        CHECK(fixed[i] == 2.5);
+    }
+    auto empty = makeShared<int[]>(0);
+    CHECK(empty.get() != nullptr);
+}
+
+// Elements are built first to last and destroyed last to first.
+void TestOrder() {
+    ResetElements();
+    {
+        auto elements = makeShared<Element[]>(3);
+        CHECK((events == std::vector<int> { 0, 1, 2 }));
+        events.clear();
+    }
+    CHECK((events == std::vector<int> { -3, -2, -1 }));
+
+    ResetElements();
+    makeShared<Element[2]>(Element());
+    CHECK((events == std::vector<int> { 0, 1, 2, -3, -2, -1 }));
+}
+
+// A throwing element constructor destroys what was built, in reverse, and
+// releases the allocation.
+void TestThrowingElement() {
+    ResetElements(3);
+    bool threw = false;
+    try {
+        allocateShared<Element[]>(CountingAllocator<Element>(), 5);
+    }
+    catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK((events == std::vector<int> { 0, 1, 2, -3, -2, -1 }));
+    CHECK(allocations == 0);
+}
+
+struct alignas(64) Wide {
+    char bytes[64];
+};
+
+void TestAlignment() {
+    for (int i = 0; i < 8; ++i) {
+        auto wide = makeShared<Wide[]>(3);
+        for (int j = 0; j < 3; ++j) {
+            CHECK(reinterpret_cast<std::uintptr_t>(&wide[j]) % alignof(Wide) == 0);
+        }
+    }
+}
+
+// An adopted array is released with delete[]; ASan reports a mismatch.
+void TestAdoptedArray() {
+    ResetElements();
+    {
+        SharedPtr<Element[]> adopted(new Element[2]);
+        WeakPtr<Element[]> weak = adopted;
+        CHECK(&adopted[1] == adopted.get() + 1);
+        CHECK(weak.lock().get() == adopted.get());
+    }
+    CHECK((events == std::vector<int> { 0, 1, -2, -1 }));
+}
+
+int main() {
+    TestSingleAllocation();
+    TestOrder();
+    TestThrowingElement();
+    TestAlignment();
+    TestAdoptedArray();
+    return 0;
+}
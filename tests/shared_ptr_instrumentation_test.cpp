@@ -0,0 +1,112 @@
+// g++ -std=c++20 -g -fsanitize=address,undefined -DSHARED_PTR_INSTRUMENTATION -I. tests/shared_ptr_instrumentation_test.cpp && ./a.out
+
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "shared_ptr.h"
+#include "tests/check.h"
+
+#ifndef SHARED_PTR_INSTRUMENTATION
+#error "build with -DSHARED_PTR_INSTRUMENTATION"
+#endif
+
+namespace probe_test {
+
+struct Single {
+    int value = 0;
+};
+
+struct Widget {
+    int value;
+
+    explicit Widget(int value) : value(value) {
+    }
+};
+
+struct Cycle {
+    SharedPtr<Cycle> self;
+};
+
+}  // namespace probe_test
+
+// A block that is never copied still has had one owner.
+void TestSingleOwner() {
+    SharedPtrTypeStats& stats = SharedPtrTypeStats::For<probe_test::Single>();
+    {
+        auto single = makeShared<probe_test::Single>();
+        CHECK(stats.blocks == 1 && stats.live == 1);
+    }
+    CHECK(stats.live == 0);
+    CHECK(stats.peak_live == 1);
+    CHECK(stats.peak_use_count == 1);
+    CHECK(stats.increments == 0);
+}
+
+void TestCounters() {
+    SharedPtrTypeStats& stats = SharedPtrTypeStats::For<probe_test::Widget>();
+    {
+        std::vector<SharedPtr<probe_test::Widget>> widgets;
+        widgets.push_back(makeShared<probe_test::Widget>(1));
+        widgets.push_back(SharedPtr<probe_test::Widget>(new probe_test::Widget(2)));
+        widgets.push_back(makeShared<probe_test::Widget>(3));
+        CHECK(stats.blocks == 3 && stats.live == 3 && stats.peak_live == 3);
+        std::vector<SharedPtr<probe_test::Widget>> copies(3, widgets[0]);
+        CHECK(stats.peak_use_count == 4);
+        CHECK(stats.increments == 3);
+        WeakPtr<probe_test::Widget> weak = widgets[1];
+        widgets[1].reset();
+        CHECK(stats.live == 2);
+        CHECK(weak.expired());
+        bool threw = false;
+        try {
+            weak.lock();
+        }
+        catch (const std::bad_weak_ptr&) {
+            threw = true;
+        }
+        CHECK(threw);
+        CHECK(stats.failed_weak_locks == 1);
+        SharedPtr<probe_test::Widget> locked = WeakPtr<probe_test::Widget>(widgets[2]).lock();
+        CHECK(stats.weak_locks == 1);
+    }
+    CHECK(stats.blocks == 3 && stats.live == 0 && stats.peak_live == 3);
+    CHECK(stats.decrements == stats.increments + stats.blocks);
+
+    std::ostringstream report;
+    reportSharedPtrTypes(report);
+    CHECK(report.str().find("probe_test::Widget: blocks 3, live 0, peak live 3") != std::string::npos);
+    CHECK(report.str().find("probe_test::Single: blocks 1") != std::string::npos);
+}
+
+// A reference cycle survives the last outside owner and shows up in the
+// dump with its demangled type and use_count.
+void TestLeakDump() {
+    auto cycle = makeShared<probe_test::Cycle>();
+    cycle->self = cycle;
+    probe_test::Cycle* leaked = cycle.get();
+    cycle.reset();
+    std::ostringstream dump;
+    dumpLiveControlBlocks(dump);
+    CHECK(dump.str().find("probe_test::Cycle block ") == 0);
+    CHECK(dump.str().find(": use_count 1, age ") != std::string::npos);
+    CHECK(dump.str().find('\n') == dump.str().size() - 1);
+    CHECK(SharedPtrTypeStats::For<probe_test::Cycle>().live == 1);
+
+    // Moved out first: resetting a SharedPtr that lives inside the object it
+    // releases would write to freed memory.
+    SharedPtr<probe_test::Cycle> last = std::move(leaked->self);
+    last.reset();
+    std::ostringstream empty;
+    dumpLiveControlBlocks(empty);
+    CHECK(empty.str().empty());
+    CHECK(SharedPtrTypeStats::For<probe_test::Cycle>().live == 0);
+}
+
+int main() {
+    TestSingleOwner();
+    TestCounters();
+    TestLeakDump();
+    return 0;
+}
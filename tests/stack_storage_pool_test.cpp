@@ -0,0 +1,54 @@
+// g++ -std=c++20 -g -fsanitize=address,undefined -pthread -I. tests/stack_storage_pool_test.cpp && ./a.out
+
+#include <optional>
+#include <thread>
+
+#include "StackAllocator.h"
+#include "tests/check.h"
+
+using Alloc = StackAllocator<int, 4096>;
+using Pool = StackStoragePool<StackStorage<4096>>;
+
+// Destroyed after main's thread_local pool; its arena must not go back there.
+List<int, Alloc> g_list;
+
+int main() {
+    for (int i = 0; i < 50; ++i) {
+        g_list.push_back(i);
+    }
+
+    {
+        List<int, Alloc> a;
+        a.push_back(1);
+        CHECK(Pool::local().idle() == 0);
+    }
+    CHECK(Pool::local().idle() == 1);
+
+    {
+        List<int, Alloc> reused;
+        reused.push_back(2);
+        CHECK(Pool::local().idle() == 0);
+    }
+
+    // An arena taken on one thread and released on another lands in the
+    // releasing thread's pool, even when that thread is exiting.
+    auto* moved = new List<int, Alloc>();
+    moved->push_back(3);
+    std::thread([moved] {
+        delete moved;
+        CHECK(Pool::local().idle() == 1);
+    }).join();
+
+    // The holder is constructed before the pool, so the pool is destroyed
+    // first when the thread exits.
+    std::thread([] {
+        thread_local std::optional<List<int, Alloc>> late;
+        late.emplace();
+        late->push_back(4);
+    }).join();
+
+    for (int i = 0; i < 50; ++i) {
+        g_list.push_back(i);
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+// g++ -std=c++20 -g -fsanitize=address,undefined -DSTACK_STORAGE_STATS -I. tests/stack_storage_stats_test.cpp && ./a.out
+
+#include <cstddef>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+#include "StackAllocator.h"
+#include "tests/check.h"
+
+#ifndef STACK_STORAGE_STATS
+#error "build with -DSTACK_STORAGE_STATS"
+#endif
+
+// Requests a byte, then eight bytes aligned to eight, then more than is
+// left; returns the padding the second request needed.
+template <typename Storage>
+std::size_t Exercise(Storage& storage) {
+    auto first = static_cast<char*>(storage.allocate_raw(1, 1));
+    auto second = static_cast<char*>(storage.allocate_raw(8, 8));
+    CHECK(first != nullptr && second != nullptr);
+    CHECK(storage.allocate_raw(1, storage.stats().capacity) == nullptr);
+    return second - (first + 1);
+}
+
+template <typename Storage>
+void TestCounters(Storage& storage) {
+    std::size_t padding = Exercise(storage);
+    CHECK(padding > 0 && padding < 8);
+    StackStorageStats stats = storage.stats();
+    CHECK(stats.bytes_requested == 9);
+    CHECK(stats.padding_bytes == padding);
+    CHECK(stats.allocations == 2);
+    CHECK(stats.failed_allocations == 1);
+    CHECK(stats.high_water_mark == 9 + padding);
+
+    // Counters add up across reset(); the high water mark keeps its peak.
+    storage.reset();
+    CHECK(storage.allocate_raw(1, 4) != nullptr);
+    stats = storage.stats();
+    CHECK(stats.bytes_requested == 13 && stats.allocations == 3);
+    CHECK(stats.high_water_mark == 9 + padding);
+}
+
+void TestReport() {
+    auto storage = std::make_unique<StackStorage<1024>>();
+    std::size_t padding = Exercise(*storage);
+    std::ostringstream out;
+    storage->stats().report(out);
+    CHECK(out.str() == "capacity: 1024\n"
+                       "high water mark: " + std::to_string(9 + padding) + "\n"
+                       "bytes requested: 9\n"
+                       "padding bytes: " + std::to_string(padding) + "\n"
+                       "allocations: 2\n"
+                       "failed allocations: 1\n");
+}
+
+// With chunking, the high water mark counts whole chunks while padding is
+// counted inside them.
+void TestChunkedConcurrentStorage() {
+    auto storage = std::make_unique<ConcurrentStackStorage<1 << 16>>(256);
+    std::size_t padding = Exercise(*storage);
+    StackStorageStats stats = storage->stats();
+    CHECK(stats.padding_bytes == padding);
+    CHECK(stats.allocations == 2 && stats.failed_allocations == 1);
+    CHECK(stats.high_water_mark == 256);
+}
+
+// Disabled counters take no space and report only the capacity.
+void TestDisabled() {
+    StackStorageCounters<std::size_t, false> counters;
+    counters.OnRequest(10);
+    counters.OnPadding(3);
+    counters.OnReach(13);
+    StackStorageStats stats = counters.stats(64);
+    CHECK(stats.capacity == 64 && stats.bytes_requested == 0 && stats.high_water_mark == 0);
+    static_assert(std::is_empty_v<StackStorageCounters<std::size_t, false>>);
+}
+
+int main() {
+    auto stack = std::make_unique<StackStorage<1024>>();
+    TestCounters(*stack);
+    auto concurrent = std::make_unique<ConcurrentStackStorage<1024>>();
+    TestCounters(*concurrent);
+    MmapStackStorage mapped(1 << 20);
+    TestCounters(mapped);
+    TestReport();
+    TestChunkedConcurrentStorage();
+    TestDisabled();
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef TESTS_TEST_UTIL_H
+#define TESTS_TEST_UTIL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <string>
+
+#include "tests/check.h"
+
+// Checks a container against the std::list it should match, both ways.
+template <typename L, typename T>
+void CheckSame(const L& list, const std::list<T>& expected) {
+    CHECK(list.size() == expected.size());
+    CHECK(std::equal(list.begin(), list.end(), expected.begin(), expected.end()));
+    CHECK(std::equal(list.rbegin(), list.rend(), expected.rbegin(), expected.rend()));
+}
+
+template <typename It>
+It Advance(It it, std::size_t steps) {
+    std::advance(it, steps);
+    return it;
+}
+
+// Turn random bits into values for the differential fuzzers.
+inline int Int(unsigned bits) {
+    return static_cast<int>(bits % 1000);
+}
+
+inline std::string String(unsigned bits) {
+    return std::string(bits % 40, static_cast<char>('a' + bits % 26));
+}
+
+// lock() throws std::bad_weak_ptr on an expired block; this returns an
+// empty pointer instead.
+template <typename Weak>
+auto TryLock(const Weak& weak) -> decltype(weak.lock()) {
+    try {
+        return weak.lock();
+    }
+    catch (const std::bad_weak_ptr&) {
+        return decltype(weak.lock())();
+    }
+}
+
+#endif  // TESTS_TEST_UTIL_H
@@ -0,0 +1,98 @@
+// g++ -std=c++20 -g -fsanitize=address,undefined -I. tests/unrolled_list_test.cpp && ./a.out
+
+#include <iterator>
+#include <list>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "StackAllocator.h"
+#include "UnrolledList.h"
+#include "tests/check.h"
+#include "tests/test_util.h"
+
+// Applies the same random operations to an UnrolledList and a std::list.
+// Inserts and erases at random positions split, borrow and merge nodes.
+template <typename L, typename T, typename Make>
+void Fuzz(L list, Make make, unsigned seed, int steps) {
+    std::mt19937 rng(seed);
+    auto pick = [&rng](std::size_t bound) {
+        return std::uniform_int_distribution<std::size_t>(0, bound)(rng);
+    };
+    std::list<T> expected;
+    for (int step = 0; step < steps; ++step) {
+        T value = make(rng());
+        switch (pick(9)) {
+        case 0:
+            list.push_back(value);
+            expected.push_back(value);
+            break;
+        case 1:
+            list.emplace_front(value);
+            expected.push_front(value);
+            break;
+        case 2:
+        case 3: {
+            std::size_t at = pick(expected.size());
+            auto it = list.insert(Advance(list.begin(), at), value);
+            CHECK(*it == value);
+            CHECK(std::distance(list.begin(), it) == static_cast<std::ptrdiff_t>(at));
+            expected.insert(Advance(expected.begin(), at), value);
+            break;
+        }
+        case 4:
+        case 5:
+            if (!expected.empty()) {
+                std::size_t at = pick(expected.size() - 1);
+                auto it = list.erase(Advance(list.begin(), at));
+                auto next = expected.erase(Advance(expected.begin(), at));
+                CHECK(std::distance(list.begin(), it) == static_cast<std::ptrdiff_t>(at));
+                CHECK(next == expected.end() || *it == *next);
+            }
+            break;
+        case 6:
+            if (!expected.empty()) {
+                list.pop_back();
+                expected.pop_back();
+            }
+            break;
+        case 7:
+            if (!expected.empty()) {
+                list.pop_front();
+                expected.pop_front();
+            }
+            break;
+        case 8: {
+            L copy(list);
+            CheckSame(copy, expected);
+            L moved(std::move(copy));
+            CheckSame(moved, expected);
+            copy = moved;
+            CheckSame(copy, expected);
+            break;
+        }
+        default:
+            if (pick(30) == 0) {
+                list.clear();
+                expected.clear();
+            }
+            break;
+        }
+        CheckSame(list, expected);
+    }
+}
+
+int main() {
+    for (unsigned seed = 1; seed <= 3; ++seed) {
+        Fuzz<UnrolledList<int, std::allocator<int>, 2>, int>({}, Int, seed, 3000);
+        Fuzz<UnrolledList<int, std::allocator<int>, 5>, int>({}, Int, seed, 3000);
+        Fuzz<UnrolledList<int>, int>({}, Int, seed, 3000);
+        Fuzz<UnrolledList<std::string, std::allocator<std::string>, 3>, std::string>({}, String, seed, 3000);
+        Fuzz<UnrolledList<std::string>, std::string>({}, String, seed, 3000);
+        MmapStackStorage storage(std::size_t(1) << 28);
+        using Arena = MmapStackAllocator<std::string>;
+        Fuzz<UnrolledList<std::string, Arena, 4>, std::string>(UnrolledList<std::string, Arena, 4>(Arena(storage)),
+                                                               String, seed, 3000);
+    }
+    return 0;
+}